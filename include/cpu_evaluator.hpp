@@ -0,0 +1,455 @@
+#pragma once
+
+#include <expression.hpp>
+#include <simd_lanes.hpp>
+
+#include <string>
+#include <vector>
+#include <span>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+#include <cstdio>
+#include <cmath>
+
+// CPU backend for graph definitions, for machines without a usable GPU and
+// for checking the compute pass. Expressions are compiled to a register
+// bytecode that is interpreted a block of lane_count grid points at a time,
+// with rows of the grid spread over all cores.
+
+enum class Opcode : uint8_t {
+    Constant, Condition, Parameter,
+    X, Y, Z, PX, PY,
+    Neg, Add, Sub, Mul, Div,
+    Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or, Not, Select,
+    Sin, Cos, Tan, Cot, Sec, Csc, Asin, Acos, Atan, Atan2,
+    Sinh, Cosh, Tanh, Asinh, Acosh, Atanh,
+    Exp, Exp2, Log, Log2, Sqrt, InverseSqrt,
+    Abs, Sign, Floor, Ceil, Round, Trunc, Fract, Radians, Degrees,
+    Pow, Mod, Min, Max, Step, Clamp, Mix, Smoothstep,
+};
+
+// operands are earlier registers; a Parameter reads element of array, 0
+// being the sliders and 1 plane_params. Conditions are masks, a constant
+// one is true when constant is not zero
+struct Instruction {
+    Opcode op;
+    int a = -1, b = -1, c = -1;
+    float constant = 0.f;
+    int array = -1, element = -1;
+};
+
+// one register per instruction, the result is the last one. Dual kernels
+// also carry the partial derivatives with respect to x and y, with the same
+// rules as the d_* helpers of dual.glsl
+struct CpuKernel {
+    std::vector<Instruction> code;
+    bool dual = false;
+
+    bool compile(const Expression& expr, bool with_derivatives, std::string& error) {
+        static const std::unordered_map<std::string, Opcode> functions = {
+            { "sin", Opcode::Sin }, { "cos", Opcode::Cos }, { "tan", Opcode::Tan }, { "cot", Opcode::Cot },
+            { "sec", Opcode::Sec }, { "csc", Opcode::Csc }, { "asin", Opcode::Asin }, { "acos", Opcode::Acos },
+            { "atan", Opcode::Atan }, { "sinh", Opcode::Sinh }, { "cosh", Opcode::Cosh }, { "tanh", Opcode::Tanh },
+            { "asinh", Opcode::Asinh }, { "acosh", Opcode::Acosh }, { "atanh", Opcode::Atanh },
+            { "exp", Opcode::Exp }, { "exp2", Opcode::Exp2 }, { "log", Opcode::Log }, { "log2", Opcode::Log2 },
+            { "sqrt", Opcode::Sqrt }, { "inversesqrt", Opcode::InverseSqrt }, { "abs", Opcode::Abs },
+            { "sign", Opcode::Sign }, { "floor", Opcode::Floor }, { "ceil", Opcode::Ceil }, { "round", Opcode::Round },
+            { "trunc", Opcode::Trunc }, { "fract", Opcode::Fract }, { "radians", Opcode::Radians },
+            { "degrees", Opcode::Degrees }, { "pow", Opcode::Pow }, { "mod", Opcode::Mod }, { "min", Opcode::Min },
+            { "max", Opcode::Max }, { "step", Opcode::Step }, { "clamp", Opcode::Clamp }, { "mix", Opcode::Mix },
+            { "smoothstep", Opcode::Smoothstep },
+        };
+        static const std::unordered_map<std::string, Opcode> variables = {
+            { "x", Opcode::X }, { "y", Opcode::Y }, { "z", Opcode::Z }, { "px", Opcode::PX }, { "py", Opcode::PY },
+        };
+
+        code.clear();
+        dual = with_derivatives;
+        if (expr.root < 0) {
+            error = "nothing to compile";
+            return false;
+        }
+        std::vector<int> reg(expr.nodes.size(), -1);
+        std::function<bool(int)> emit = [&](int n) {
+            if (reg[n] >= 0) return true;
+            const ExprNode& node = expr.nodes[n];
+            for (int i = 0; i < node.nargs; i++)
+                if (!emit(node.args[i])) return false;
+            Instruction ins{ Opcode::Constant };
+            if (node.nargs > 0) ins.a = reg[node.args[0]];
+            if (node.nargs > 1) ins.b = reg[node.args[1]];
+            if (node.nargs > 2) ins.c = reg[node.args[2]];
+            switch (node.op) {
+            case Op::Number:
+                ins.op = node.is_bool ? Opcode::Condition : Opcode::Constant;
+                ins.constant = (float)node.value;
+                break;
+            case Op::Variable: {
+                auto it = variables.find(node.name);
+                if (it == variables.end()) {
+                    error = std::format("variable '{}' is not available on the CPU", node.name);
+                    return false;
+                }
+                ins.op = it->second;
+                break;
+            }
+            case Op::Parameter: {
+                int index;
+                ins.op = Opcode::Parameter;
+                if (sscanf(node.name.c_str(), "sliders[%d]", &index) == 1) ins.array = 0;
+                else if (sscanf(node.name.c_str(), "plane_params[%d]", &index) == 1) ins.array = 1;
+                else {
+                    error = std::format("parameter '{}' is not available on the CPU", node.name);
+                    return false;
+                }
+                ins.element = index;
+                break;
+            }
+            case Op::Neg: ins.op = Opcode::Neg; break;
+            case Op::Not: ins.op = Opcode::Not; break;
+            case Op::Add: ins.op = Opcode::Add; break;
+            case Op::Sub: ins.op = Opcode::Sub; break;
+            case Op::Mul: ins.op = Opcode::Mul; break;
+            case Op::Div: ins.op = Opcode::Div; break;
+            case Op::Less: ins.op = Opcode::Less; break;
+            case Op::LessEqual: ins.op = Opcode::LessEqual; break;
+            case Op::Greater: ins.op = Opcode::Greater; break;
+            case Op::GreaterEqual: ins.op = Opcode::GreaterEqual; break;
+            case Op::Equal: ins.op = Opcode::Equal; break;
+            case Op::NotEqual: ins.op = Opcode::NotEqual; break;
+            case Op::And: ins.op = Opcode::And; break;
+            case Op::Or: ins.op = Opcode::Or; break;
+            case Op::Select: ins.op = Opcode::Select; break;
+            case Op::Call: {
+                auto it = functions.find(node.name);
+                if (it == functions.end()) {
+                    error = std::format("function '{}' is not available on the CPU", node.name);
+                    return false;
+                }
+                ins.op = it->second == Opcode::Atan && node.nargs == 2 ? Opcode::Atan2 : it->second;
+                break;
+            } }
+            code.push_back(ins);
+            reg[n] = (int)code.size() - 1;
+            return true;
+        };
+        if (!emit(expr.root)) {
+            code.clear();
+            return false;
+        }
+        return true;
+    }
+};
+
+// everything a kernel reads besides its own registers, for one block of lanes
+struct KernelInputs {
+    Lanes x, y, z, px, py;
+    std::span<const float> sliders;
+    const float* plane_params;
+};
+
+struct DualLanes {
+    Lanes v, dx, dy;
+};
+
+inline void run_kernel(const CpuKernel& k, std::vector<DualLanes>& r, const KernelInputs& in) {
+    r.resize(k.code.size());
+    const Lanes zero = lanes(0.f), one = lanes(1.f);
+    for (size_t i = 0; i < k.code.size(); i++) {
+        const Instruction& ins = k.code[i];
+        const DualLanes& a = r[ins.a < 0 ? i : ins.a];
+        const DualLanes& b = r[ins.b < 0 ? i : ins.b];
+        const DualLanes& c = r[ins.c < 0 ? i : ins.c];
+        DualLanes d{ zero, zero, zero };
+
+        // value; the derivative of constants and step functions stays zero
+        switch (ins.op) {
+        case Opcode::Constant: d.v = lanes(ins.constant); break;
+        case Opcode::Condition: d.v = ins.constant != 0.f ? zero == zero : zero != zero; break;
+        case Opcode::Parameter: {
+            float p = 0.f;
+            if (ins.array == 0 && ins.element < (int)in.sliders.size()) p = in.sliders[ins.element];
+            if (ins.array == 1 && ins.element < 5) p = in.plane_params[ins.element];
+            d.v = lanes(p);
+            break;
+        }
+        case Opcode::X: d = { in.x, one, zero }; break;
+        case Opcode::Y: d = { in.y, zero, one }; break;
+        case Opcode::Z: d.v = in.z; break;
+        case Opcode::PX: d.v = in.px; break;
+        case Opcode::PY: d.v = in.py; break;
+        case Opcode::Neg: d.v = -a.v; break;
+        case Opcode::Add: d.v = a.v + b.v; break;
+        case Opcode::Sub: d.v = a.v - b.v; break;
+        case Opcode::Mul: d.v = a.v * b.v; break;
+        case Opcode::Div: d.v = a.v / b.v; break;
+        case Opcode::Less: d.v = a.v < b.v; break;
+        case Opcode::LessEqual: d.v = a.v <= b.v; break;
+        case Opcode::Greater: d.v = a.v > b.v; break;
+        case Opcode::GreaterEqual: d.v = a.v >= b.v; break;
+        case Opcode::Equal: d.v = a.v == b.v; break;
+        case Opcode::NotEqual: d.v = a.v != b.v; break;
+        case Opcode::And: d.v = a.v & b.v; break;
+        case Opcode::Or: d.v = a.v | b.v; break;
+        case Opcode::Not: d.v = ~a.v; break;
+        case Opcode::Select:
+            d = { select(a.v, b.v, c.v), select(a.v, b.dx, c.dx), select(a.v, b.dy, c.dy) };
+            break;
+        case Opcode::Sin: d.v = sin(a.v); break;
+        case Opcode::Cos: d.v = cos(a.v); break;
+        case Opcode::Tan: d.v = sin(a.v) / cos(a.v); break;
+        case Opcode::Cot: d.v = cos(a.v) / sin(a.v); break;
+        case Opcode::Sec: d.v = 1.f / cos(a.v); break;
+        case Opcode::Csc: d.v = 1.f / sin(a.v); break;
+        case Opcode::Asin: d.v = per_lane([](float v) { return std::asin(v); }, a.v); break;
+        case Opcode::Acos: d.v = per_lane([](float v) { return std::acos(v); }, a.v); break;
+        case Opcode::Atan: d.v = per_lane([](float v) { return std::atan(v); }, a.v); break;
+        case Opcode::Atan2: d.v = per_lane([](float v, float w) { return std::atan2(v, w); }, a.v, b.v); break;
+        case Opcode::Sinh: d.v = (exp(a.v) - exp(-a.v)) * 0.5f; break;
+        case Opcode::Cosh: d.v = (exp(a.v) + exp(-a.v)) * 0.5f; break;
+        case Opcode::Tanh: d.v = per_lane([](float v) { return std::tanh(v); }, a.v); break;
+        case Opcode::Asinh: d.v = per_lane([](float v) { return std::asinh(v); }, a.v); break;
+        case Opcode::Acosh: d.v = per_lane([](float v) { return std::acosh(v); }, a.v); break;
+        case Opcode::Atanh: d.v = per_lane([](float v) { return std::atanh(v); }, a.v); break;
+        case Opcode::Exp: d.v = exp(a.v); break;
+        case Opcode::Exp2: d.v = exp(a.v * 0.693147180559945f); break;
+        case Opcode::Log: d.v = log(a.v); break;
+        case Opcode::Log2: d.v = log(a.v) * 1.44269504088896341f; break;
+        case Opcode::Sqrt: d.v = sqrt(a.v); break;
+        case Opcode::InverseSqrt: d.v = 1.f / sqrt(a.v); break;
+        case Opcode::Abs: d.v = abs(a.v); break;
+        case Opcode::Sign: d.v = sign(a.v); break;
+        case Opcode::Floor: d.v = floor(a.v); break;
+        case Opcode::Ceil: d.v = ceil(a.v); break;
+        case Opcode::Round: d.v = round(a.v); break;
+        case Opcode::Trunc: d.v = trunc(a.v); break;
+        case Opcode::Fract: d.v = a.v - floor(a.v); break;
+        case Opcode::Radians: d.v = a.v * 0.017453292519943295f; break;
+        case Opcode::Degrees: d.v = a.v * 57.29577951308232f; break;
+        case Opcode::Pow: d.v = exp(b.v * log(a.v)); break;
+        case Opcode::Mod: d.v = a.v - b.v * floor(a.v / b.v); break;
+        case Opcode::Min: d = { select(a.v <= b.v, a.v, b.v), select(a.v <= b.v, a.dx, b.dx), select(a.v <= b.v, a.dy, b.dy) }; break;
+        case Opcode::Max: d = { select(a.v >= b.v, a.v, b.v), select(a.v >= b.v, a.dx, b.dx), select(a.v >= b.v, a.dy, b.dy) }; break;
+        case Opcode::Step: d.v = select(b.v < a.v, zero, one); break;
+        case Opcode::Clamp: {
+            Lanes low = a.v < b.v, high = a.v > c.v;
+            d = { select(low, b.v, select(high, c.v, a.v)), select(low, b.dx, select(high, c.dx, a.dx)), select(low, b.dy, select(high, c.dy, a.dy)) };
+            break;
+        }
+        case Opcode::Mix: d.v = a.v + (b.v - a.v) * c.v; break;
+        case Opcode::Smoothstep: {
+            Lanes t = min(max((c.v - a.v) / (b.v - a.v), zero), one);
+            d.v = t * t * (3.f - 2.f * t);
+            break;
+        } }
+
+        if (k.dual) {
+            // factor of the chain rule for functions of one argument
+            Lanes f = zero;
+            bool unary = true;
+            switch (ins.op) {
+            case Opcode::Neg: f = lanes(-1.f); break;
+            case Opcode::Sin: f = cos(a.v); break;
+            case Opcode::Cos: f = -sin(a.v); break;
+            case Opcode::Tan: f = 1.f + d.v * d.v; break;
+            case Opcode::Cot: f = -(1.f + d.v * d.v); break;
+            case Opcode::Sec: f = d.v * sin(a.v) / cos(a.v); break;
+            case Opcode::Csc: f = -d.v * cos(a.v) / sin(a.v); break;
+            case Opcode::Asin: f = 1.f / sqrt(1.f - a.v * a.v); break;
+            case Opcode::Acos: f = -1.f / sqrt(1.f - a.v * a.v); break;
+            case Opcode::Atan: f = 1.f / (1.f + a.v * a.v); break;
+            case Opcode::Sinh: f = (exp(a.v) + exp(-a.v)) * 0.5f; break;
+            case Opcode::Cosh: f = (exp(a.v) - exp(-a.v)) * 0.5f; break;
+            case Opcode::Tanh: f = 1.f - d.v * d.v; break;
+            case Opcode::Asinh: f = 1.f / sqrt(a.v * a.v + 1.f); break;
+            case Opcode::Acosh: f = 1.f / sqrt(a.v * a.v - 1.f); break;
+            case Opcode::Atanh: f = 1.f / (1.f - a.v * a.v); break;
+            case Opcode::Exp: f = d.v; break;
+            case Opcode::Exp2: f = d.v * 0.693147180559945f; break;
+            case Opcode::Log: f = 1.f / a.v; break;
+            case Opcode::Log2: f = 1.f / (a.v * 0.693147180559945f); break;
+            case Opcode::Sqrt: f = 1.f / (2.f * d.v); break;
+            case Opcode::InverseSqrt: f = -0.5f * d.v / a.v; break;
+            case Opcode::Abs: f = sign(a.v); break;
+            case Opcode::Fract: f = one; break;
+            case Opcode::Radians: f = lanes(0.017453292519943295f); break;
+            case Opcode::Degrees: f = lanes(57.29577951308232f); break;
+            default: unary = false;
+            }
+            if (unary) {
+                d.dx = f * a.dx;
+                d.dy = f * a.dy;
+            }
+            switch (ins.op) {
+            case Opcode::Add: d.dx = a.dx + b.dx; d.dy = a.dy + b.dy; break;
+            case Opcode::Sub: d.dx = a.dx - b.dx; d.dy = a.dy - b.dy; break;
+            case Opcode::Mul: d.dx = a.v * b.dx + b.v * a.dx; d.dy = a.v * b.dy + b.v * a.dy; break;
+            case Opcode::Div: {
+                Lanes q = 1.f / (b.v * b.v);
+                d.dx = (a.dx * b.v - a.v * b.dx) * q;
+                d.dy = (a.dy * b.v - a.v * b.dy) * q;
+                break;
+            }
+            case Opcode::Atan2: {
+                Lanes q = 1.f / (a.v * a.v + b.v * b.v);
+                d.dx = (b.v * a.dx - a.v * b.dx) * q;
+                d.dy = (b.v * a.dy - a.v * b.dy) * q;
+                break;
+            }
+            case Opcode::Pow: {
+                // the log term only where the exponent varies, as in d_pow
+                Lanes f = b.v * exp((b.v - 1.f) * log(a.v));
+                Lanes varies = (b.dx != zero) | (b.dy != zero);
+                Lanes g = select(varies, d.v * log(a.v), zero);
+                d.dx = f * a.dx + select(varies, g * b.dx, zero);
+                d.dy = f * a.dy + select(varies, g * b.dy, zero);
+                break;
+            }
+            case Opcode::Mod: {
+                Lanes q = floor(a.v / b.v);
+                d.dx = a.dx - q * b.dx;
+                d.dy = a.dy - q * b.dy;
+                break;
+            }
+            case Opcode::Mix:
+                d.dx = a.dx + (b.dx - a.dx) * c.v + (b.v - a.v) * c.dx;
+                d.dy = a.dy + (b.dy - a.dy) * c.v + (b.v - a.v) * c.dy;
+                break;
+            case Opcode::Smoothstep: {
+                // d/dt of t^2 (3 - 2t) times dt, t clamped to [0, 1]
+                Lanes w = b.v - a.v;
+                Lanes t = (c.v - a.v) / w;
+                Lanes inside = (t > zero) & (t < one);
+                Lanes f = select(inside, 6.f * t * (1.f - t), zero);
+                // dt = ((dc - da) w - (c - a)(db - da)) / w^2
+                d.dx = f * ((c.dx - a.dx) - t * (b.dx - a.dx)) / w;
+                d.dy = f * ((c.dy - a.dy) - t * (b.dy - a.dy)) / w;
+                break;
+            }
+            default: break;
+            }
+        }
+        r[i] = d;
+    }
+}
+
+// Evaluates a definition with the scalar field and region of compute.glsl
+// over the same cell-centred lattice, writing the layout of gridbuffer:
+// per point vec4(z / zoomz, in_region, dz/dx, dz/dy) and vec4(normal, 0)
+class CpuEvaluator {
+public:
+    static constexpr int point_floats = 8;
+
+    bool compile(const Expression& f, const Expression& scalar_field, const Expression& region, std::string& error) {
+        return function.compile(f, true, error) && scalar.compile(scalar_field, false, error) && inside.compile(region, false, error);
+    }
+
+    bool compiled() const {
+        return !function.code.empty();
+    }
+
+    struct View {
+        int grid_res;
+        float zoomx, zoomy, zoomz;
+        float centerx, centery;
+    };
+
+    void evaluate(float* grid, const View& view, std::span<const float> sliders, const float plane_params[5]) const {
+        for_rows(view.grid_res, [&](int row, std::vector<DualLanes>& r) {
+            for (int col = 0; col < view.grid_res; col += lane_count) {
+                Lanes val, region, px, py;
+                evaluate_block(view, row, col, sliders, plane_params, r, val, region, px, py);
+                float v[4][lane_count];
+                store(v[0], val * lanes(1.f / view.zoomz));
+                store(v[1], select(region, lanes(1.f), lanes(0.f)));
+                store(v[2], px);
+                store(v[3], py);
+                // normalize(vec3(px * zoomx, -zoomz, py * zoomy))
+                Lanes nx = px * view.zoomx, ny = lanes(-view.zoomz), nz = py * view.zoomy;
+                Lanes inv = 1.f / sqrt(nx * nx + ny * ny + nz * nz);
+                float n[3][lane_count];
+                store(n[0], nx * inv);
+                store(n[1], ny * inv);
+                store(n[2], nz * inv);
+                int count = std::min(lane_count, view.grid_res - col);
+                for (int l = 0; l < count; l++) {
+                    float* p = grid + ((size_t)row * view.grid_res + col + l) * point_floats;
+                    p[0] = v[0][l];
+                    p[1] = v[1][l];
+                    p[2] = v[2][l];
+                    p[3] = v[3][l];
+                    p[4] = n[0][l];
+                    p[5] = n[1][l];
+                    p[6] = n[2][l];
+                    p[7] = 0.f;
+                }
+            }
+        });
+    }
+
+    // the scalar field summed over the points inside the region, skipping
+    // NaN and infinity, as the reduce mode of compute.glsl does
+    double sum(const View& view, std::span<const float> sliders, const float plane_params[5]) const {
+        std::vector<double> rows(view.grid_res, 0.0);
+        for_rows(view.grid_res, [&](int row, std::vector<DualLanes>& r) {
+            double s = 0.0;
+            for (int col = 0; col < view.grid_res; col += lane_count) {
+                Lanes val, region, px, py;
+                evaluate_block(view, row, col, sliders, plane_params, r, val, region, px, py);
+                float v[lane_count], m[lane_count];
+                store(v, val);
+                store(m, select(region, lanes(1.f), lanes(0.f)));
+                int count = std::min(lane_count, view.grid_res - col);
+                for (int l = 0; l < count; l++)
+                    if (m[l] != 0.f && std::isfinite(v[l])) s += v[l];
+            }
+            rows[row] = s;
+        });
+        // rows are added in order, so the result does not depend on the thread count
+        double total = 0.0;
+        for (double s : rows) total += s;
+        return total;
+    }
+
+private:
+    CpuKernel function, scalar, inside;
+
+    void evaluate_block(const View& view, int row, int col, std::span<const float> sliders, const float plane_params[5], std::vector<DualLanes>& r,
+                        Lanes& val, Lanes& region, Lanes& px, Lanes& py) const {
+        float xs[lane_count];
+        for (int l = 0; l < lane_count; l++) xs[l] = ((col + l) + 0.5f) / view.grid_res - 0.5f;
+        KernelInputs in{};
+        in.x = load(xs) * view.zoomx + view.centerx;
+        in.y = lanes(view.zoomy * ((row + 0.5f) / view.grid_res - 0.5f) + view.centery);
+        in.sliders = sliders;
+        in.plane_params = plane_params;
+
+        run_kernel(function, r, in);
+        const DualLanes& f = r[function.code.size() - 1];
+        in.z = f.v;
+        in.px = px = f.dx;
+        in.py = py = f.dy;
+        run_kernel(scalar, r, in);
+        val = r[scalar.code.size() - 1].v;
+        run_kernel(inside, r, in);
+        region = r[inside.code.size() - 1].v;
+    }
+
+    // calls row(index, registers) for every row, on as many threads as there are cores
+    template<class Row>
+    static void for_rows(int rows, Row row) {
+        std::atomic<int> next = 0;
+        auto work = [&] {
+            std::vector<DualLanes> registers;
+            for (int i = next++; i < rows; i = next++) row(i, registers);
+        };
+        int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), rows);
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads; i++) pool.emplace_back(work);
+        work();
+        for (std::thread& t : pool) t.join();
+    }
+};
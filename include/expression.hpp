@@ -0,0 +1,708 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <unordered_map>
+#include <functional>
+#include <format>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+
+// Compiler for the expression language of graph definitions. Source text is
+// tokenized and parsed into a hash-consed DAG, so identical subexpressions
+// share a node; constants are folded while the DAG is built, and nodes used
+// more than once are emitted as GLSL temporaries.
+
+enum class Op {
+    Number,     // value, boolean when is_bool
+    Variable,   // name is a free variable of the expression (x, y)
+    Parameter,  // name is a GLSL lvalue constant over the grid (sliders[i], plane_params[i])
+    Neg, Not,
+    Add, Sub, Mul, Div,
+    Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual,
+    And, Or,
+    Select,     // args[0] ? args[1] : args[2]
+    Call,       // name(args...)
+};
+
+struct ExprNode {
+    Op op;
+    double value = 0.0;
+    std::string name{};
+    int args[3] = { -1, -1, -1 };
+    int nargs = 0;
+    bool is_bool = false;
+};
+
+struct ExprFunction {
+    int min_args, max_args;
+    std::function<double(double, double, double)> fold;
+};
+
+inline const std::unordered_map<std::string, ExprFunction>& expr_functions() {
+    static const std::unordered_map<std::string, ExprFunction> functions = {
+        { "sin", { 1, 1, [](double a, double, double) { return std::sin(a); } } },
+        { "cos", { 1, 1, [](double a, double, double) { return std::cos(a); } } },
+        { "tan", { 1, 1, [](double a, double, double) { return std::tan(a); } } },
+        { "cot", { 1, 1, [](double a, double, double) { return 1.0 / std::tan(a); } } },
+        { "sec", { 1, 1, [](double a, double, double) { return 1.0 / std::cos(a); } } },
+        { "csc", { 1, 1, [](double a, double, double) { return 1.0 / std::sin(a); } } },
+        { "asin", { 1, 1, [](double a, double, double) { return std::asin(a); } } },
+        { "acos", { 1, 1, [](double a, double, double) { return std::acos(a); } } },
+        { "atan", { 1, 2, [](double a, double b, double) { return std::isnan(b) ? std::atan(a) : std::atan2(a, b); } } },
+        { "sinh", { 1, 1, [](double a, double, double) { return std::sinh(a); } } },
+        { "cosh", { 1, 1, [](double a, double, double) { return std::cosh(a); } } },
+        { "tanh", { 1, 1, [](double a, double, double) { return std::tanh(a); } } },
+        { "asinh", { 1, 1, [](double a, double, double) { return std::asinh(a); } } },
+        { "acosh", { 1, 1, [](double a, double, double) { return std::acosh(a); } } },
+        { "atanh", { 1, 1, [](double a, double, double) { return std::atanh(a); } } },
+        { "exp", { 1, 1, [](double a, double, double) { return std::exp(a); } } },
+        { "exp2", { 1, 1, [](double a, double, double) { return std::exp2(a); } } },
+        { "log", { 1, 1, [](double a, double, double) { return std::log(a); } } },
+        { "log2", { 1, 1, [](double a, double, double) { return std::log2(a); } } },
+        { "sqrt", { 1, 1, [](double a, double, double) { return std::sqrt(a); } } },
+        { "inversesqrt", { 1, 1, [](double a, double, double) { return 1.0 / std::sqrt(a); } } },
+        { "abs", { 1, 1, [](double a, double, double) { return std::abs(a); } } },
+        { "sign", { 1, 1, [](double a, double, double) { return (double)((a > 0.0) - (a < 0.0)); } } },
+        { "floor", { 1, 1, [](double a, double, double) { return std::floor(a); } } },
+        { "ceil", { 1, 1, [](double a, double, double) { return std::ceil(a); } } },
+        { "round", { 1, 1, [](double a, double, double) { return std::round(a); } } },
+        { "trunc", { 1, 1, [](double a, double, double) { return std::trunc(a); } } },
+        { "fract", { 1, 1, [](double a, double, double) { return a - std::floor(a); } } },
+        { "radians", { 1, 1, [](double a, double, double) { return a * 0.017453292519943295; } } },
+        { "degrees", { 1, 1, [](double a, double, double) { return a * 57.29577951308232; } } },
+        { "pow", { 2, 2, [](double a, double b, double) { return std::pow(a, b); } } },
+        { "mod", { 2, 2, [](double a, double b, double) { return a - b * std::floor(a / b); } } },
+        { "min", { 2, 2, [](double a, double b, double) { return std::min(a, b); } } },
+        { "max", { 2, 2, [](double a, double b, double) { return std::max(a, b); } } },
+        { "step", { 2, 2, [](double a, double b, double) { return b < a ? 0.0 : 1.0; } } },
+        { "clamp", { 3, 3, [](double a, double b, double c) { return std::min(std::max(a, b), c); } } },
+        { "mix", { 3, 3, [](double a, double b, double c) { return a * (1.0 - c) + b * c; } } },
+        { "float", { 1, 1, [](double a, double, double) { return a; } } },
+        { "smoothstep", { 3, 3, [](double a, double b, double c) {
+            double t = std::min(std::max((c - a) / (b - a), 0.0), 1.0);
+            return t * t * (3.0 - 2.0 * t);
+        } } },
+    };
+    return functions;
+}
+
+struct Symbol {
+    enum Kind {
+        Variable,   // free variable, emitted by name
+        Constant,   // folded to value
+        Slider,     // sliders[slider]
+        Array,      // name[i] for constant 0 <= i < length
+        Macro,      // expands to the parsed source text
+    } kind;
+    double value = 0.0;
+    int slider = -1;
+    int length = 0;
+    std::string source{};
+};
+
+class SymbolTable {
+public:
+    std::unordered_map<std::string, Symbol> symbols;
+
+    void add_variable(const std::string& name) { symbols[name] = { Symbol::Variable }; }
+    void add_constant(const std::string& name, double value) { symbols[name] = { Symbol::Constant, value }; }
+    void add_slider(const std::string& name, int index) { symbols[name] = { Symbol::Slider, 0.0, index }; }
+    void add_array(const std::string& name, int length) { symbols[name] = { Symbol::Array, 0.0, -1, length }; }
+    void add_macro(const std::string& name, const std::string& source) { symbols[name] = { Symbol::Macro, 0.0, -1, 0, source }; }
+
+    const Symbol* find(const std::string& name) const {
+        auto it = symbols.find(name);
+        return it == symbols.end() ? nullptr : &it->second;
+    }
+};
+
+class Expression {
+public:
+    std::vector<ExprNode> nodes;
+    int root = -1;
+    std::vector<int> used_sliders;
+
+    // parses source against symbols, returns false and fills error on
+    // failure; a condition instead of a number is expected when condition is set
+    bool parse(const std::string& source, const SymbolTable& symbols, std::string& error, bool condition = false) {
+        nodes.clear();
+        cache.clear();
+        used_sliders.clear();
+        table = &symbols;
+        depth = 0;
+        try {
+            root = parse_source(source);
+            if (nodes[root].is_bool && !condition) fail("expression must be a number, not a condition");
+            if (!nodes[root].is_bool && condition) fail("expression must be a condition, not a number");
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+            root = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool uses_slider(int index) const {
+        return std::find(used_sliders.begin(), used_sliders.end(), index) != used_sliders.end();
+    }
+
+    // GLSL statements computing the expression, the last one being
+    // `return <expr>;`, with every shared subexpression bound to a temporary
+    std::string glsl() const {
+        std::vector<int> refs(nodes.size(), 0);
+        std::vector<bool> seen(nodes.size(), false);
+        std::function<void(int)> count = [&](int n) {
+            refs[n]++;
+            if (seen[n]) return;
+            seen[n] = true;
+            for (int i = 0; i < nodes[n].nargs; i++) count(nodes[n].args[i]);
+        };
+        count(root);
+
+        std::string body;
+        std::vector<std::string> names(nodes.size());
+        int temporaries = 0;
+        std::function<void(int)> hoist = [&](int n) {
+            if (!names[n].empty()) return;
+            for (int i = 0; i < nodes[n].nargs; i++) hoist(nodes[n].args[i]);
+            const ExprNode& node = nodes[n];
+            bool leaf = node.op == Op::Number || node.op == Op::Variable || node.op == Op::Parameter;
+            if (n != root && refs[n] > 1 && !leaf) {
+                names[n] = std::format("_t{}", temporaries++);
+                body += std::format("{} {} = {};\n\t", node.is_bool ? "bool" : "float", names[n], emit(n, names, 0, true));
+            }
+        };
+        hoist(root);
+        body += std::format("return {};", emit(root, names, 0, true));
+        return body;
+    }
+
+    // forward-mode differentiation: GLSL statements computing the dual
+    // number vec3(f, df/dx, df/dy) of the expression in one pass, the last
+    // one being `return <dual>;`, x and y being the variables named first
+    // and second. Every numeric node gets a temporary; the d_* helpers
+    // carrying the derivative rules are defined in dual.glsl
+    std::string dual_glsl(const std::string& first = "x", const std::string& second = "y") const {
+        const std::string seeds[2]{ first, second };
+        std::string body;
+        std::vector<std::string> names(nodes.size());
+        int temporaries = 0;
+        std::function<void(int)> visit = [&](int n) {
+            const ExprNode& node = nodes[n];
+            if (!names[n].empty() || node.op == Op::Number || node.op == Op::Variable || node.op == Op::Parameter) return;
+            for (int i = 0; i < node.nargs; i++) visit(node.args[i]);
+            if (node.is_bool) return;
+            names[n] = std::format("_d{}", temporaries++);
+            body += std::format("vec3 {} = {};\n\t", names[n], emit_dual(n, names, seeds));
+        };
+        visit(root);
+        body += std::format("return {};", dual_operand(root, names, seeds));
+        return body;
+    }
+
+private:
+    struct Token {
+        enum Type { Number, Identifier, Operator, End } type;
+        std::string text;
+        double value = 0.0;
+        size_t column = 0;
+    };
+
+    const SymbolTable* table = nullptr;
+    std::unordered_map<std::string, int> cache;
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    int depth = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(message);
+    }
+
+    [[noreturn]] void fail_at(const Token& token, const std::string& message) const {
+        if (token.type == Token::End) fail(std::format("{} at end of expression", message));
+        fail(std::format("{} at column {}", message, token.column + 1));
+    }
+
+    std::vector<Token> tokenize(const std::string& source) const {
+        std::vector<Token> result;
+        size_t i = 0;
+        while (i < source.size()) {
+            char c = source[i];
+            if (isspace((unsigned char)c)) {
+                i++;
+                continue;
+            }
+            Token token;
+            token.column = i;
+            if (isdigit((unsigned char)c) || (c == '.' && i + 1 < source.size() && isdigit((unsigned char)source[i + 1]))) {
+                char* end;
+                token.type = Token::Number;
+                token.value = std::strtod(source.c_str() + i, &end);
+                size_t next = end - source.c_str();
+                if (next < source.size() && (source[next] == 'f' || source[next] == 'F')) next++;
+                token.text = source.substr(i, next - i);
+                i = next;
+            } else if (isalpha((unsigned char)c) || c == '_') {
+                size_t start = i;
+                while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_')) i++;
+                token.type = Token::Identifier;
+                token.text = source.substr(start, i - start);
+            } else {
+                static const char* operators[] = { "<=", ">=", "==", "!=", "&&", "||", "+", "-", "*", "/", "^", "<", ">", "!", "?", ":", "(", ")", "[", "]", "," };
+                token.type = Token::Operator;
+                for (const char* op : operators) {
+                    if (source.compare(i, strlen(op), op) == 0) {
+                        token.text = op;
+                        break;
+                    }
+                }
+                if (token.text.empty()) fail(std::format("unexpected character '{}' at column {}", c, i + 1));
+                i += token.text.size();
+            }
+            result.push_back(token);
+        }
+        Token end;
+        end.type = Token::End;
+        end.column = source.size();
+        result.push_back(end);
+        return result;
+    }
+
+    // macros are parsed with their own token stream
+    int parse_source(const std::string& source) {
+        if (++depth > 16) fail("symbol definitions are too deeply nested");
+        std::vector<Token> saved_tokens = std::move(tokens);
+        size_t saved_pos = pos;
+        tokens = tokenize(source);
+        pos = 0;
+        if (tokens[0].type == Token::End) fail("empty expression");
+        int n = parse_expression();
+        if (peek().type != Token::End) fail_at(peek(), std::format("unexpected '{}'", peek().text));
+        tokens = std::move(saved_tokens);
+        pos = saved_pos;
+        depth--;
+        return n;
+    }
+
+    const Token& peek() const { return tokens[pos]; }
+    bool accept(const char* op) {
+        if (peek().type == Token::Operator && peek().text == op) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    void expect(const char* op) {
+        if (!accept(op)) fail_at(peek(), std::format("expected '{}'", op));
+    }
+
+    int parse_expression() {
+        size_t start = pos;
+        int cond = parse_binary(0);
+        if (!accept("?")) return cond;
+        if (!nodes[cond].is_bool) fail_at(tokens[start], "condition of '?' must be a comparison");
+        int a = parse_expression();
+        expect(":");
+        int b = parse_expression();
+        if (nodes[a].is_bool != nodes[b].is_bool) fail("both branches of '?' must have the same type");
+        return make(Op::Select, { cond, a, b });
+    }
+
+    struct BinaryOp {
+        const char* text;
+        Op op;
+        int level;
+    };
+
+    int parse_binary(int level) {
+        static const BinaryOp operators[] = {
+            { "||", Op::Or, 0 }, { "&&", Op::And, 1 },
+            { "==", Op::Equal, 2 }, { "!=", Op::NotEqual, 2 },
+            { "<", Op::Less, 3 }, { "<=", Op::LessEqual, 3 }, { ">", Op::Greater, 3 }, { ">=", Op::GreaterEqual, 3 },
+            { "+", Op::Add, 4 }, { "-", Op::Sub, 4 },
+            { "*", Op::Mul, 5 }, { "/", Op::Div, 5 },
+        };
+        if (level > 5) return parse_unary();
+        int lhs = parse_binary(level + 1);
+        while (true) {
+            const BinaryOp* match = nullptr;
+            if (peek().type == Token::Operator)
+                for (const BinaryOp& b : operators)
+                    if (b.level == level && peek().text == b.text) match = &b;
+            if (!match) return lhs;
+            const Token& token = tokens[pos++];
+            int rhs = parse_binary(level + 1);
+            bool logical = match->op == Op::And || match->op == Op::Or;
+            if (nodes[lhs].is_bool != logical || nodes[rhs].is_bool != logical)
+                fail_at(token, logical ? std::format("operands of '{}' must be comparisons", token.text) : std::format("operands of '{}' must be numbers", token.text));
+            lhs = make(match->op, { lhs, rhs });
+        }
+    }
+
+    int parse_unary() {
+        const Token& token = peek();
+        if (accept("-")) return make(Op::Neg, { number_operand(token, parse_unary()) });
+        if (accept("+")) return number_operand(token, parse_unary());
+        if (accept("!")) {
+            int a = parse_unary();
+            if (!nodes[a].is_bool) fail_at(token, "operand of '!' must be a comparison");
+            return make(Op::Not, { a });
+        }
+        return parse_power();
+    }
+
+    // right associative and binds tighter than unary minus, -x^2 is -(x^2)
+    int parse_power() {
+        int base = parse_primary();
+        const Token& token = peek();
+        if (!accept("^")) return base;
+        int exponent = parse_unary();
+        number_operand(token, base);
+        number_operand(token, exponent);
+        return power(base, exponent);
+    }
+
+    int number_operand(const Token& token, int n) {
+        if (nodes[n].is_bool) fail_at(token, std::format("operand of '{}' must be a number", token.text));
+        return n;
+    }
+
+    int parse_primary() {
+        const Token token = peek();
+        if (token.type == Token::Number) {
+            pos++;
+            return number(token.value);
+        }
+        if (accept("(")) {
+            int n = parse_expression();
+            expect(")");
+            return n;
+        }
+        if (token.type != Token::Identifier) fail_at(token, token.type == Token::End ? "expected a value" : std::format("unexpected '{}'", token.text));
+        pos++;
+
+        if (accept("(")) {
+            auto it = expr_functions().find(token.text);
+            if (it == expr_functions().end()) fail_at(token, std::format("unknown function '{}'", token.text));
+            std::vector<int> args;
+            if (!accept(")")) {
+                do {
+                    const Token& arg = peek();
+                    int a = parse_expression();
+                    if (nodes[a].is_bool) fail_at(arg, std::format("arguments of '{}' must be numbers", token.text));
+                    args.push_back(a);
+                } while (accept(","));
+                expect(")");
+            }
+            const ExprFunction& f = it->second;
+            if ((int)args.size() < f.min_args || (int)args.size() > f.max_args) {
+                if (f.min_args == f.max_args)
+                    fail_at(token, std::format("'{}' takes {} argument{}", token.text, f.min_args, f.min_args == 1 ? "" : "s"));
+                fail_at(token, std::format("'{}' takes {} to {} arguments", token.text, f.min_args, f.max_args));
+            }
+            return call(token.text, args);
+        }
+
+        // the literals of conditions, as the region of a graph that is not integrated
+        if (token.text == "true" || token.text == "false") return number(token.text == "true", true);
+
+        const Symbol* symbol = table->find(token.text);
+        if (!symbol) {
+            if (expr_functions().count(token.text)) fail_at(token, std::format("'{}' is a function", token.text));
+            fail_at(token, std::format("undeclared identifier '{}'", token.text));
+        }
+        switch (symbol->kind) {
+        case Symbol::Variable:
+            return leaf(Op::Variable, token.text);
+        case Symbol::Constant:
+            return number(symbol->value);
+        case Symbol::Slider:
+            if (!uses_slider(symbol->slider)) used_sliders.push_back(symbol->slider);
+            return leaf(Op::Parameter, std::format("sliders[{}]", symbol->slider));
+        case Symbol::Macro:
+            return parse_source(symbol->source);
+        case Symbol::Array: {
+            expect("[");
+            const Token& index_token = peek();
+            int index = parse_expression();
+            expect("]");
+            const ExprNode& i = nodes[index];
+            if (i.op != Op::Number || i.is_bool || i.value != std::floor(i.value) || i.value < 0 || i.value >= symbol->length)
+                fail_at(index_token, std::format("index of '{}' must be a constant from 0 to {}", token.text, symbol->length - 1));
+            return leaf(Op::Parameter, std::format("{}[{}]", token.text, (int)i.value));
+        } }
+        fail_at(token, "invalid symbol");
+    }
+
+    // node construction, folding and hash-consing
+
+    int intern(const ExprNode& node) {
+        std::string key = std::format("{}|{}|{}|{}|{}|{}|{}", (int)node.op, node.value, node.name, node.args[0], node.args[1], node.args[2], node.is_bool);
+        auto it = cache.find(key);
+        if (it != cache.end()) return it->second;
+        nodes.push_back(node);
+        cache[key] = (int)nodes.size() - 1;
+        return (int)nodes.size() - 1;
+    }
+
+    int number(double value, bool is_bool = false) {
+        ExprNode node{ Op::Number, value };
+        node.is_bool = is_bool;
+        return intern(node);
+    }
+
+    int leaf(Op op, const std::string& name) {
+        ExprNode node{ op };
+        node.name = name;
+        return intern(node);
+    }
+
+    // folded constants are emitted as float literals
+    static bool foldable(double r) {
+        return std::isfinite((float)r);
+    }
+
+    bool is_number(int n, double value) const {
+        return nodes[n].op == Op::Number && !nodes[n].is_bool && nodes[n].value == value;
+    }
+
+    int make(Op op, std::initializer_list<int> args) {
+        ExprNode node{ op };
+        for (int a : args) node.args[node.nargs++] = a;
+        const int* a = node.args;
+        node.is_bool = (op >= Op::Less && op <= Op::Or) || op == Op::Not || (op == Op::Select && nodes[a[1]].is_bool);
+
+        bool constant = true;
+        for (int i = 0; i < node.nargs; i++) constant &= nodes[a[i]].op == Op::Number;
+        if (constant) {
+            double v[3]{};
+            for (int i = 0; i < node.nargs; i++) v[i] = nodes[a[i]].value;
+            double r = 0.0;
+            switch (op) {
+            case Op::Neg: r = -v[0]; break;
+            case Op::Not: r = v[0] == 0.0; break;
+            case Op::Add: r = v[0] + v[1]; break;
+            case Op::Sub: r = v[0] - v[1]; break;
+            case Op::Mul: r = v[0] * v[1]; break;
+            case Op::Div: r = v[0] / v[1]; break;
+            case Op::Less: r = v[0] < v[1]; break;
+            case Op::LessEqual: r = v[0] <= v[1]; break;
+            case Op::Greater: r = v[0] > v[1]; break;
+            case Op::GreaterEqual: r = v[0] >= v[1]; break;
+            case Op::Equal: r = v[0] == v[1]; break;
+            case Op::NotEqual: r = v[0] != v[1]; break;
+            case Op::And: r = v[0] != 0.0 && v[1] != 0.0; break;
+            case Op::Or: r = v[0] != 0.0 || v[1] != 0.0; break;
+            case Op::Select: r = v[0] != 0.0 ? v[1] : v[2]; break;
+            default: break;
+            }
+            if (foldable(r)) return number(r, node.is_bool);
+        }
+        if (op == Op::Select && nodes[a[0]].op == Op::Number) return nodes[a[0]].value != 0.0 ? a[1] : a[2];
+        if (op == Op::Select && a[1] == a[2]) return a[1];
+
+        // identities that hold for every float, NaN and infinity included, up
+        // to the sign of a zero: x + 0 and 0 - x give -0 where x is -0 and +0
+        // respectively, which only a division by the result could tell apart
+        switch (op) {
+        case Op::Neg:
+            if (nodes[a[0]].op == Op::Neg) return nodes[a[0]].args[0];
+            break;
+        case Op::Add:
+            if (is_number(a[0], 0.0)) return a[1];
+            if (is_number(a[1], 0.0)) return a[0];
+            if (nodes[a[1]].op == Op::Neg) return make(Op::Sub, { a[0], nodes[a[1]].args[0] });
+            break;
+        case Op::Sub:
+            if (is_number(a[1], 0.0)) return a[0];
+            if (is_number(a[0], 0.0)) return make(Op::Neg, { a[1] });
+            break;
+        case Op::Mul:
+            if (is_number(a[0], 1.0)) return a[1];
+            if (is_number(a[1], 1.0)) return a[0];
+            if (is_number(a[0], -1.0)) return make(Op::Neg, { a[1] });
+            if (is_number(a[1], -1.0)) return make(Op::Neg, { a[0] });
+            break;
+        case Op::Div:
+            if (is_number(a[1], 1.0)) return a[0];
+            break;
+        default:
+            break;
+        }
+        // keep commutative operands in a canonical order so a*b and b*a share a node
+        if ((op == Op::Add || op == Op::Mul || op == Op::Equal || op == Op::NotEqual || op == Op::And || op == Op::Or) && node.args[0] > node.args[1])
+            std::swap(node.args[0], node.args[1]);
+        return intern(node);
+    }
+
+    int call(const std::string& name, const std::vector<int>& args) {
+        if (name == "float") return args[0]; // the GLSL constructor, used by integration regions
+        ExprNode node{ Op::Call };
+        node.name = name;
+        bool constant = true;
+        double v[3] = { NAN, NAN, NAN };
+        for (int a : args) {
+            constant &= nodes[a].op == Op::Number;
+            v[node.nargs] = nodes[a].value;
+            node.args[node.nargs++] = a;
+        }
+        if (constant) {
+            double r = expr_functions().at(name).fold(v[0], v[1], v[2]);
+            if (foldable(r)) return number(r);
+        }
+        if (name == "pow") return power(args[0], args[1]);
+        return intern(node);
+    }
+
+    // small integer powers become products, which unlike pow() are defined
+    // for negative bases
+    int power(int base, int exponent) {
+        double e = nodes[exponent].value;
+        if (nodes[exponent].op == Op::Number && e == std::floor(e) && std::abs(e) <= 4.0) {
+            int n = (int)std::abs(e);
+            int result = number(1.0);
+            if (n >= 1) result = base;
+            if (n >= 2) result = make(Op::Mul, { base, base });
+            if (n == 3) result = make(Op::Mul, { result, base });
+            if (n == 4) result = make(Op::Mul, { result, result });
+            return e < 0.0 ? make(Op::Div, { number(1.0), result }) : result;
+        }
+        if (nodes[base].op == Op::Number && nodes[exponent].op == Op::Number) {
+            double r = std::pow(nodes[base].value, nodes[exponent].value);
+            if (foldable(r)) return number(r);
+        }
+        ExprNode node{ Op::Call };
+        node.name = "pow";
+        node.args[0] = base;
+        node.args[1] = exponent;
+        node.nargs = 2;
+        return intern(node);
+    }
+
+    // emission
+
+    static int precedence(Op op) {
+        switch (op) {
+        case Op::Select: return 1;
+        case Op::Or: return 2;
+        case Op::And: return 3;
+        case Op::Equal: case Op::NotEqual: return 4;
+        case Op::Less: case Op::LessEqual: case Op::Greater: case Op::GreaterEqual: return 5;
+        case Op::Add: case Op::Sub: return 6;
+        case Op::Mul: case Op::Div: return 7;
+        case Op::Neg: case Op::Not: return 8;
+        default: return 9;
+        }
+    }
+
+    static std::string literal(double value) {
+        std::string s = std::format("{}", (float)value);
+        if (s.find_first_of(".e") == std::string::npos) s += ".0";
+        return s;
+    }
+
+    std::string emit(int n, const std::vector<std::string>& names, int parent, bool top = false) const {
+        if (!top && !names[n].empty()) return names[n];
+        const ExprNode& node = nodes[n];
+        int p = precedence(node.op);
+        std::string s;
+        switch (node.op) {
+        case Op::Number:
+            if (node.is_bool) return node.value != 0.0 ? "true" : "false";
+            s = literal(node.value);
+            if (node.value < 0.0) p = 8;
+            break;
+        case Op::Variable:
+        case Op::Parameter:
+            return node.name;
+        case Op::Neg:
+        case Op::Not:
+            s = std::string(node.op == Op::Neg ? "-" : "!") + emit(node.args[0], names, p);
+            // keep "- -x" from turning into a decrement
+            if (s[1] == '-') s.insert(1, " ");
+            break;
+        case Op::Select:
+            s = std::format("{} ? {} : {}", emit(node.args[0], names, p + 1), emit(node.args[1], names, p), emit(node.args[2], names, p));
+            break;
+        case Op::Call:
+            s = node.name + "(";
+            for (int i = 0; i < node.nargs; i++) {
+                if (i) s += ", ";
+                s += emit(node.args[i], names, 0);
+            }
+            s += ")";
+            break;
+        default: {
+            static const std::unordered_map<Op, const char*> symbols = {
+                { Op::Add, " + " }, { Op::Sub, " - " }, { Op::Mul, " * " }, { Op::Div, " / " },
+                { Op::Less, " < " }, { Op::LessEqual, " <= " }, { Op::Greater, " > " }, { Op::GreaterEqual, " >= " },
+                { Op::Equal, " == " }, { Op::NotEqual, " != " }, { Op::And, " && " }, { Op::Or, " || " },
+            };
+            // left associative, so only the right operand needs parentheses at equal precedence
+            s = emit(node.args[0], names, p) + symbols.at(node.op) + emit(node.args[1], names, p + 1);
+        } }
+        return p < parent ? "(" + s + ")" : s;
+    }
+
+    // a numeric node as a dual number, or a condition over the values of its
+    // operands; seeds are the variables differentiated by, see dual_glsl
+    std::string dual_operand(int n, const std::vector<std::string>& names, const std::string (&seeds)[2]) const {
+        if (!names[n].empty()) return names[n];
+        const ExprNode& node = nodes[n];
+        switch (node.op) {
+        case Op::Number:
+            if (node.is_bool) return node.value != 0.0 ? "true" : "false";
+            return std::format("vec3({}, 0.f, 0.f)", literal(node.value));
+        case Op::Variable:
+            if (node.name == seeds[0]) return std::format("vec3({}, 1.f, 0.f)", node.name);
+            if (node.name == seeds[1]) return std::format("vec3({}, 0.f, 1.f)", node.name);
+            return std::format("vec3({}, 0.f, 0.f)", node.name);
+        case Op::Parameter:
+            return std::format("vec3({}, 0.f, 0.f)", node.name);
+        case Op::Not:
+            return "!" + dual_operand(node.args[0], names, seeds);
+        case Op::Select:
+            return std::format("({} ? {} : {})", dual_operand(node.args[0], names, seeds), dual_operand(node.args[1], names, seeds), dual_operand(node.args[2], names, seeds));
+        case Op::And:
+        case Op::Or:
+            return std::format("({} {} {})", dual_operand(node.args[0], names, seeds), node.op == Op::And ? "&&" : "||", dual_operand(node.args[1], names, seeds));
+        default: {
+            // comparisons look at the values only
+            static const std::unordered_map<Op, const char*> symbols = {
+                { Op::Less, "<" }, { Op::LessEqual, "<=" }, { Op::Greater, ">" }, { Op::GreaterEqual, ">=" },
+                { Op::Equal, "==" }, { Op::NotEqual, "!=" },
+            };
+            return std::format("({} {} {})", dual_value(node.args[0], names), symbols.at(node.op), dual_value(node.args[1], names));
+        } }
+    }
+
+    std::string dual_value(int n, const std::vector<std::string>& names) const {
+        if (!names[n].empty()) return names[n] + ".x";
+        return emit(n, names, 9);
+    }
+
+    std::string emit_dual(int n, const std::vector<std::string>& names, const std::string (&seeds)[2]) const {
+        const ExprNode& node = nodes[n];
+        auto arg = [&](int i) { return dual_operand(node.args[i], names, seeds); };
+        switch (node.op) {
+        case Op::Neg: return "-" + arg(0);
+        case Op::Add: return std::format("{} + {}", arg(0), arg(1));
+        case Op::Sub: return std::format("{} - {}", arg(0), arg(1));
+        case Op::Mul: return std::format("d_mul({}, {})", arg(0), arg(1));
+        case Op::Div: return std::format("d_div({}, {})", arg(0), arg(1));
+        case Op::Select: return std::format("{} ? {} : {}", arg(0), arg(1), arg(2));
+        default: {
+            std::string s = "d_" + node.name + "(";
+            for (int i = 0; i < node.nargs; i++) {
+                if (i) s += ", ";
+                s += arg(i);
+            }
+            return s + ")";
+        } }
+    }
+};
@@ -0,0 +1,538 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <initializer_list>
+#include <utility>
+#include <filesystem>
+#include <fstream>
+#include <format>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <algorithm>
+
+// GL_KHR_parallel_shader_compile, not part of the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Linked programs keyed by a hash of their final shader sources. Programs in
+// use are reference counted; released ones stay resident until evicted in
+// least recently used order. Linked binaries are also written to disk with
+// glGetProgramBinary so that a restart can skip compilation entirely; every
+// load touches its file, and the least recently used files are pruned when
+// the disk cache is opened.
+//
+// request() and poll() compile without stalling the caller, either through
+// GL_KHR_parallel_shader_compile or on a worker thread that owns a context
+// shared with the main one.
+class ProgramCache {
+    struct Entry {
+        GLuint program;
+        int refs;
+        uint64_t last_use;
+    };
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t key;
+        uint64_t driver;
+    };
+    // a program requested but not yet handed out, shared by every request of the same sources
+    struct InFlight {
+        GLuint program = 0;
+        std::vector<GLuint> shaders; // only with parallel compile, the worker cleans up its own
+        int requests = 1;
+        bool finished = false;
+        bool failed = false;
+        std::string log;
+    };
+    struct Job {
+        uint64_t key;
+        std::vector<std::pair<GLenum, std::string>> stages{};
+    };
+    struct Result {
+        uint64_t key;
+        GLuint program;
+        std::string log{};
+    };
+    static constexpr uint32_t magic = 0x54525042; // "BPRT"
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<GLuint, uint64_t> keys;
+    uint64_t clock = 0;
+    uint64_t driver = 0;
+    std::filesystem::path directory;
+    bool disk = false;
+
+    std::unordered_map<uint64_t, InFlight> pending;
+    bool parallel = false;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done; // a result was pushed
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    bool stopping = false;
+
+    static uint64_t fnv1a(const void* data, size_t size, uint64_t h = 14695981039346656037ull) {
+        for (size_t i = 0; i < size; i++) {
+            h ^= static_cast<const unsigned char*>(data)[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static uint64_t hash_stages(std::span<const std::pair<GLenum, const char*>> stages) {
+        uint64_t key = 14695981039346656037ull;
+        for (const auto& [type, source] : stages) {
+            key = fnv1a(&type, sizeof(type), key);
+            key = fnv1a(source, strlen(source) + 1, key);
+        }
+        return key;
+    }
+
+    // compiles and links into program, waiting for the driver; fills log on
+    // failure, the caller deletes program then
+    static bool build(GLuint program, std::span<const std::pair<GLenum, const char*>> stages, std::string& log) {
+        int success;
+        std::vector<GLuint> shaders;
+        for (const auto& [type, source] : stages) {
+            GLuint shader = glCreateShader(type);
+            glShaderSource(shader, 1, &source, NULL);
+            glCompileShader(shader);
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            shaders.push_back(shader);
+            if (!success) {
+                char temp[1024];
+                glGetShaderInfoLog(shader, 1024, NULL, temp);
+                log = temp;
+                for (GLuint s : shaders) glDeleteShader(s);
+                return false;
+            }
+            glAttachShader(program, shader);
+        }
+        glLinkProgram(program);
+        for (GLuint s : shaders) {
+            glDetachShader(program, s);
+            glDeleteShader(s);
+        }
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char temp[1024];
+            glGetProgramInfoLog(program, 1024, NULL, temp);
+            log = temp;
+            return false;
+        }
+        return true;
+    }
+
+    void insert(uint64_t key, GLuint program, int refs) {
+        entries[key] = { program, refs, ++clock };
+        keys[program] = key;
+    }
+
+    void run_worker(std::function<void()> make_current) {
+        make_current();
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            std::vector<std::pair<GLenum, const char*>> stages;
+            for (const auto& [type, source] : job.stages) stages.emplace_back(type, source.c_str());
+            Result result{ job.key, glCreateProgram() };
+            glProgramParameteri(result.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            if (!build(result.program, stages, result.log)) {
+                glDeleteProgram(result.program);
+                result.program = 0;
+            }
+            // the program becomes visible to the main context once the worker's commands completed
+            glFinish();
+
+            lock.lock();
+            results.push_back(std::move(result));
+            done.notify_all();
+        }
+    }
+
+    // moves finished compiles into pending, deleting those nobody waits for anymore
+    void collect() {
+        if (parallel) {
+            for (auto& [key, p] : pending) {
+                if (p.finished) continue;
+                int done = GL_FALSE;
+                glGetProgramiv(p.program, GL_COMPLETION_STATUS_KHR, &done);
+                if (!done) continue;
+                p.finished = true;
+                int success;
+                for (GLuint s : p.shaders) {
+                    glGetShaderiv(s, GL_COMPILE_STATUS, &success);
+                    if (!success && !p.failed) {
+                        char temp[1024];
+                        glGetShaderInfoLog(s, 1024, NULL, temp);
+                        p.log = temp;
+                        p.failed = true;
+                    }
+                    glDetachShader(p.program, s);
+                    glDeleteShader(s);
+                }
+                p.shaders.clear();
+                glGetProgramiv(p.program, GL_LINK_STATUS, &success);
+                if (!success && !p.failed) {
+                    char temp[1024];
+                    glGetProgramInfoLog(p.program, 1024, NULL, temp);
+                    p.log = temp;
+                    p.failed = true;
+                }
+                if (p.failed) {
+                    glDeleteProgram(p.program);
+                    p.program = 0;
+                }
+                else finish(key, p);
+            }
+            return;
+        }
+        std::vector<Result> done;
+        {
+            std::lock_guard lock(mutex);
+            done.swap(results);
+        }
+        for (Result& r : done) {
+            auto it = pending.find(r.key);
+            // a second compile of the same key, requested again after a cancel
+            // while the first was still running, finds the pending one finished
+            if (it == pending.end() || it->second.finished) {
+                // superseded while compiling, keep it around in case it is typed again
+                if (r.program != 0 && entries.contains(r.key)) glDeleteProgram(r.program);
+                else if (r.program != 0) {
+                    store_binary(r.key, r.program);
+                    insert(r.key, r.program, 0);
+                    evict();
+                }
+                continue;
+            }
+            InFlight& p = it->second;
+            p.finished = true;
+            p.program = r.program;
+            p.failed = r.program == 0;
+            p.log = std::move(r.log);
+            if (!p.failed) finish(r.key, p);
+        }
+    }
+
+    // a successfully linked program enters the cache holding one reference per waiting request
+    void finish(uint64_t key, InFlight& p) {
+        store_binary(key, p.program);
+        insert(key, p.program, p.requests);
+    }
+
+    // blocks until the compile of a pending request has finished
+    void wait_for(uint64_t key) {
+        while (!pending.at(key).finished) {
+            if (parallel) {
+                // querying the link status waits for the driver's threads
+                int success;
+                glGetProgramiv(pending.at(key).program, GL_LINK_STATUS, &success);
+            }
+            else {
+                std::unique_lock lock(mutex);
+                done.wait(lock, [&] { return !results.empty(); });
+            }
+            collect();
+        }
+    }
+
+    std::filesystem::path binary_path(uint64_t key) const {
+        return directory / std::format("{:016x}.bin", key);
+    }
+
+    bool load_binary(uint64_t key, GLuint program) {
+        if (!disk) return false;
+        std::ifstream in(binary_path(key), std::ios::binary);
+        if (!in) return false;
+        BinaryHeader header{};
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (header.magic != magic || header.key != key || header.driver != driver || binary.empty()) return false;
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (success) {
+            // used, so the last to be pruned
+            std::error_code ec;
+            std::filesystem::last_write_time(binary_path(key), std::filesystem::file_time_type::clock::now(), ec);
+        }
+        return success;
+    }
+
+    void store_binary(uint64_t key, GLuint program) {
+        if (!disk) return;
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<char> binary(length);
+        GLenum format;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+        BinaryHeader header{ magic, format, key, driver };
+        std::ofstream out(binary_path(key), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), binary.size());
+    }
+
+    // deletes binaries, least recently used first by modification time,
+    // until at most disk_entries of them totalling disk_bytes are left
+    void prune_disk() {
+        struct File {
+            std::filesystem::path path;
+            std::filesystem::file_time_type time;
+            uintmax_t size;
+        };
+        std::vector<File> files;
+        uintmax_t total = 0;
+        std::error_code ec;
+        for (const auto& f : std::filesystem::directory_iterator(directory, ec)) {
+            if (f.path().extension() != ".bin") continue;
+            std::error_code time_error, size_error;
+            File file{ f.path(), f.last_write_time(time_error), f.file_size(size_error) };
+            if (time_error || size_error) continue;
+            total += file.size;
+            files.push_back(std::move(file));
+        }
+        std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.time < b.time; });
+        size_t left = files.size();
+        for (const File& file : files) {
+            if (left <= disk_entries && total <= disk_bytes) break;
+            std::filesystem::remove(file.path, ec);
+            total -= file.size;
+            left--;
+        }
+    }
+
+    void evict() {
+        size_t unused = 0;
+        for (const auto& [key, e] : entries)
+            if (e.refs == 0) unused++;
+        while (unused > capacity) {
+            auto oldest = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+                if (it->second.refs == 0 && (oldest == entries.end() || it->second.last_use < oldest->second.last_use))
+                    oldest = it;
+            glDeleteProgram(oldest->second.program);
+            keys.erase(oldest->second.program);
+            entries.erase(oldest);
+            unused--;
+        }
+    }
+
+public:
+    // number of released programs kept resident
+    size_t capacity = 64;
+    // binaries left on disk when it is opened, every definition typed adds one
+    size_t disk_entries = 512;
+    uintmax_t disk_bytes = 64ull << 20;
+
+    // enables the on-disk store; needs a current context, binaries are
+    // tagged with the renderer and driver version they were produced by
+    void open_disk_cache(const std::filesystem::path& dir) {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (formats == 0 || ec) return;
+        driver = 14695981039346656037ull;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char* s = reinterpret_cast<const char*>(glGetString(name));
+            if (s) driver = fnv1a(s, strlen(s), driver);
+        }
+        directory = dir;
+        disk = true;
+        prune_disk();
+    }
+
+    // returns a linked program for the given stages, from memory, disk or a
+    // fresh compile; returns 0 and fills log if compiling or linking fails.
+    // Sources already requested are waited for instead of compiled again
+    GLuint acquire(std::initializer_list<std::pair<GLenum, const char*>> stages, std::string& log) {
+        uint64_t key = hash_stages(stages);
+        if (pending.contains(key)) {
+            wait_for(key);
+            const InFlight& p = pending.at(key);
+            if (p.failed) {
+                log = p.log;
+                return 0;
+            }
+        }
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.refs++;
+            it->second.last_use = ++clock;
+            return it->second.program;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        if (!load_binary(key, program)) {
+            if (!build(program, stages, log)) {
+                glDeleteProgram(program);
+                return 0;
+            }
+            store_binary(key, program);
+        }
+        insert(key, program, 1);
+        return program;
+    }
+
+    enum Status {
+        Pending,
+        Ready,
+        Failed,
+    };
+
+    // compiles on the driver's threads; max_threads is glMaxShaderCompilerThreadsKHR
+    void use_parallel_compile(PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads) {
+        if (max_threads) max_threads(0xFFFFFFFF);
+        parallel = true;
+    }
+
+    // compiles on a thread of its own; make_current is called on that thread
+    // and must bind a context sharing objects with the caller's
+    void start_worker(std::function<void()> make_current) {
+        worker = std::thread(&ProgramCache::run_worker, this, std::move(make_current));
+    }
+
+    // joins the worker, whose context must still exist; to be called before
+    // the windows are destroyed, the destructor runs too late for that
+    void stop_worker() {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    ~ProgramCache() {
+        stop_worker();
+    }
+
+    // like acquire(), but returns Pending instead of waiting for the driver;
+    // the program is then handed out by poll() with the returned ticket.
+    // Falls back to acquire() when neither parallel compile nor a worker is available
+    Status request(std::initializer_list<std::pair<GLenum, const char*>> stages, uint64_t& ticket, GLuint& program, std::string& log) {
+        uint64_t key = hash_stages(stages);
+        if (entries.contains(key) || (!parallel && !worker.joinable())) {
+            program = acquire(stages, log);
+            return program ? Ready : Failed;
+        }
+        auto it = pending.find(key);
+        if (it != pending.end()) {
+            it->second.requests++;
+            ticket = key;
+            return Pending;
+        }
+
+        if (disk) {
+            GLuint binary = glCreateProgram();
+            glProgramParameteri(binary, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            if (load_binary(key, binary)) {
+                insert(key, binary, 1);
+                program = binary;
+                return Ready;
+            }
+            glDeleteProgram(binary);
+        }
+
+        InFlight& p = pending[key];
+        if (parallel) {
+            // no status is queried here, that would wait for the compile to finish
+            p.program = glCreateProgram();
+            glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            for (const auto& [type, source] : stages) {
+                GLuint shader = glCreateShader(type);
+                glShaderSource(shader, 1, &source, NULL);
+                glCompileShader(shader);
+                glAttachShader(p.program, shader);
+                p.shaders.push_back(shader);
+            }
+            glLinkProgram(p.program);
+        }
+        else {
+            Job job{ key };
+            for (const auto& [type, source] : stages) job.stages.emplace_back(type, source);
+            {
+                std::lock_guard lock(mutex);
+                jobs.push_back(std::move(job));
+            }
+            wake.notify_one();
+        }
+        ticket = key;
+        return Pending;
+    }
+
+    // hands out the program of a request once it is ready, the ticket is
+    // spent unless Pending is returned
+    Status poll(uint64_t ticket, GLuint& program, std::string& log) {
+        collect();
+        auto it = pending.find(ticket);
+        if (it == pending.end()) {
+            log = "program request expired";
+            return Failed;
+        }
+        InFlight& p = it->second;
+        if (!p.finished) return Pending;
+        Status status = p.failed ? Failed : Ready;
+        if (p.failed) log = p.log;
+        else {
+            program = p.program;
+            entries[ticket].last_use = ++clock;
+        }
+        if (--p.requests == 0) pending.erase(it);
+        return status;
+    }
+
+    // gives up a request, e.g. when a newer keystroke superseded it; a
+    // compile nobody waits for anymore is dropped where possible
+    void cancel(uint64_t ticket) {
+        auto it = pending.find(ticket);
+        if (it == pending.end()) return;
+        InFlight& p = it->second;
+        if (p.finished) {
+            if (!p.failed) release(p.program);
+            if (--p.requests == 0) pending.erase(it);
+            return;
+        }
+        if (--p.requests > 0) return;
+        if (parallel) {
+            for (GLuint s : p.shaders) glDeleteShader(s);
+            glDeleteProgram(p.program);
+        }
+        else {
+            std::lock_guard lock(mutex);
+            std::erase_if(jobs, [&](const Job& job) { return job.key == ticket; });
+        }
+        pending.erase(it);
+    }
+
+    void release(GLuint program) {
+        auto it = keys.find(program);
+        if (it == keys.end()) return;
+        Entry& e = entries[it->second];
+        if (e.refs > 0) e.refs--;
+        if (e.refs == 0) evict();
+    }
+};
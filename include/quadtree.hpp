@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Restricted quadtree over the cells of a grid_res x grid_res lattice, for
+// meshing a graph with fewer triangles where it is flat. A node of level l
+// spans 2^l cells per side; quadtree.glsl writes the error of every node,
+// the largest deviation from its bilinear patch of the points its split would
+// add, saturated with the errors of its children. Nodes over the lattice's
+// edge report an infinite error, so they are always split.
+class Quadtree {
+public:
+    int grid_res = 0;
+    int levels = 0;                 // the root is at level levels, one node spanning the lattice
+    std::vector<int> res, offset;   // nodes per side and first error of every level, 0 unused
+    int error_count = 0;
+
+    explicit Quadtree(int grid_res) : grid_res(grid_res) {
+        int cells = grid_res - 1;
+        while ((1 << levels) < cells) levels++;
+        res.assign(levels + 1, 0);
+        offset.assign(levels + 1, 0);
+        int total = 0;
+        for (int l = 1; l <= levels; l++) {
+            res[l] = (cells + (1 << l) - 1) >> l;
+            offset[l] = total;
+            total += res[l] * res[l];
+        }
+        error_count = total;
+    }
+
+    // splits every node with an error above tolerance, then the neighbours'
+    // parents of every split node so that adjacent leaves differ by at most
+    // one level, and emits the triangles of the leaves as lattice indices
+    // y * grid_res + x. Edges shared with a finer leaf get its midpoint, so
+    // the mesh has no cracks
+    void build(const std::vector<float>& errors, float tolerance, std::vector<uint32_t>& indices) {
+        split.assign(levels + 1, {});
+        for (int l = 1; l <= levels; l++) {
+            split[l].resize((size_t)res[l] * res[l]);
+            for (int i = 0; i < res[l] * res[l]; i++)
+                split[l][i] = errors[offset[l] + i] > tolerance;
+        }
+        // bottom up, a split only ever forces splits at the level above
+        for (int l = 1; l < levels; l++) {
+            for (int y = 0; y < res[l]; y++) {
+                for (int x = 0; x < res[l]; x++) {
+                    if (!split[l][y * res[l] + x]) continue;
+                    const int dx[]{ 0, 1, 0, -1, 0 }, dy[]{ 0, 0, 1, 0, -1 };
+                    for (int k = 0; k < 5; k++) {
+                        int nx = x + dx[k], ny = y + dy[k];
+                        if (nx < 0 || ny < 0 || nx >= res[l] || ny >= res[l]) continue;
+                        split[l + 1][(ny / 2) * res[l + 1] + nx / 2] = true;
+                    }
+                }
+            }
+        }
+        indices.clear();
+        emit(levels, 0, 0, indices);
+    }
+
+    // triangles a uniform mesh of the same lattice has
+    size_t uniform_triangles() const {
+        return 2ull * (grid_res - 1) * (grid_res - 1);
+    }
+
+private:
+    std::vector<std::vector<uint8_t>> split;
+
+    uint32_t index(int x, int y) const {
+        return (uint32_t)y * grid_res + x;
+    }
+
+    bool is_split(int l, int x, int y) const {
+        return l > 0 && x >= 0 && y >= 0 && x < res[l] && y < res[l] && split[l][y * res[l] + x];
+    }
+
+    void quad(int x, int y, std::vector<uint32_t>& indices) const {
+        indices.insert(indices.end(), { index(x, y), index(x + 1, y), index(x + 1, y + 1) });
+        indices.insert(indices.end(), { index(x, y), index(x + 1, y + 1), index(x, y + 1) });
+    }
+
+    void emit(int l, int x, int y, std::vector<uint32_t>& indices) const {
+        int size = 1 << l;
+        int x0 = x * size, y0 = y * size;
+        if (x0 >= grid_res - 1 || y0 >= grid_res - 1) return;
+        if (l == 0) {
+            quad(x0, y0, indices);
+            return;
+        }
+        if (is_split(l, x, y)) {
+            for (int k = 0; k < 4; k++)
+                emit(l - 1, 2 * x + (k & 1), 2 * y + (k >> 1), indices);
+            return;
+        }
+        // fan around the center, counter-clockwise from the bottom edge
+        int h = size / 2;
+        uint32_t center = index(x0 + h, y0 + h);
+        const int cx[]{ 0, size, size, 0, 0 }, cy[]{ 0, 0, size, size, 0 };
+        const int nx[]{ 0, 1, 0, -1 }, ny[]{ -1, 0, 1, 0 };
+        for (int e = 0; e < 4; e++) {
+            uint32_t a = index(x0 + cx[e], y0 + cy[e]);
+            uint32_t b = index(x0 + cx[e + 1], y0 + cy[e + 1]);
+            if (is_split(l, x + nx[e], y + ny[e])) {
+                uint32_t mid = index(x0 + (cx[e] + cx[e + 1]) / 2, y0 + (cy[e] + cy[e + 1]) / 2);
+                indices.insert(indices.end(), { center, a, mid, center, mid, b });
+            }
+            else indices.insert(indices.end(), { center, a, b });
+        }
+    }
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LANES_AVX2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LANES_NEON
+#endif
+
+// A fixed number of floats processed together: AVX2 or NEON registers when
+// the compiler targets them, otherwise plain arrays the optimiser can
+// vectorise. Comparisons return masks, which are Lanes with every bit of a
+// lane set or cleared. Bits holds the same lanes as 32 bit integers.
+
+#if defined(LANES_AVX2)
+
+constexpr int lane_count = 8;
+
+struct Lanes { __m256 v; };
+struct Bits { __m256i v; };
+
+inline Lanes lanes(float f) { return { _mm256_set1_ps(f) }; }
+inline Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void store(float* p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Lanes sqrt(Lanes a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Lanes floor(Lanes a) { return { _mm256_floor_ps(a.v) }; }
+inline Lanes ceil(Lanes a) { return { _mm256_ceil_ps(a.v) }; }
+inline Lanes trunc(Lanes a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC) }; }
+inline Lanes round(Lanes a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+inline Lanes operator<(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Lanes operator<=(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline Lanes operator==(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+inline Lanes operator&(Lanes a, Lanes b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline Lanes operator|(Lanes a, Lanes b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline Lanes operator~(Lanes a) { return { _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+
+inline Bits bits(int32_t i) { return { _mm256_set1_epi32(i) }; }
+inline Bits to_bits(Lanes a) { return { _mm256_castps_si256(a.v) }; }
+inline Lanes from_bits(Bits a) { return { _mm256_castsi256_ps(a.v) }; }
+inline Bits to_int(Lanes a) { return { _mm256_cvtps_epi32(a.v) }; }
+inline Lanes to_float(Bits a) { return { _mm256_cvtepi32_ps(a.v) }; }
+inline Bits operator+(Bits a, Bits b) { return { _mm256_add_epi32(a.v, b.v) }; }
+inline Bits operator-(Bits a, Bits b) { return { _mm256_sub_epi32(a.v, b.v) }; }
+inline Bits operator&(Bits a, Bits b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline Bits operator|(Bits a, Bits b) { return { _mm256_or_si256(a.v, b.v) }; }
+template<int n> inline Bits shift_left(Bits a) { return { _mm256_slli_epi32(a.v, n) }; }
+template<int n> inline Bits shift_right(Bits a) { return { _mm256_srli_epi32(a.v, n) }; }
+inline Lanes operator==(Bits a, Bits b) { return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v)) }; }
+
+#elif defined(LANES_NEON)
+
+constexpr int lane_count = 4;
+
+struct Lanes { float32x4_t v; };
+struct Bits { int32x4_t v; };
+
+inline Lanes lanes(float f) { return { vdupq_n_f32(f) }; }
+inline Lanes load(const float* p) { return { vld1q_f32(p) }; }
+inline void store(float* p, Lanes a) { vst1q_f32(p, a.v); }
+
+inline Lanes operator+(Lanes a, Lanes b) { return { vaddq_f32(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { vsubq_f32(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { vmulq_f32(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { vdivq_f32(a.v, b.v) }; }
+inline Lanes operator-(Lanes a) { return { vnegq_f32(a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { vminq_f32(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { vmaxq_f32(a.v, b.v) }; }
+inline Lanes sqrt(Lanes a) { return { vsqrtq_f32(a.v) }; }
+inline Lanes floor(Lanes a) { return { vrndmq_f32(a.v) }; }
+inline Lanes ceil(Lanes a) { return { vrndpq_f32(a.v) }; }
+inline Lanes trunc(Lanes a) { return { vrndq_f32(a.v) }; }
+inline Lanes round(Lanes a) { return { vrndnq_f32(a.v) }; }
+
+inline Lanes operator<(Lanes a, Lanes b) { return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+inline Lanes operator<=(Lanes a, Lanes b) { return { vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)) }; }
+inline Lanes operator==(Lanes a, Lanes b) { return { vreinterpretq_f32_u32(vceqq_f32(a.v, b.v)) }; }
+inline Lanes operator&(Lanes a, Lanes b) { return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+inline Lanes operator|(Lanes a, Lanes b) { return { vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+inline Lanes operator~(Lanes a) { return { vreinterpretq_f32_u32(vmvnq_u32(vreinterpretq_u32_f32(a.v))) }; }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) { return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) }; }
+
+inline Bits bits(int32_t i) { return { vdupq_n_s32(i) }; }
+inline Bits to_bits(Lanes a) { return { vreinterpretq_s32_f32(a.v) }; }
+inline Lanes from_bits(Bits a) { return { vreinterpretq_f32_s32(a.v) }; }
+inline Bits to_int(Lanes a) { return { vcvtnq_s32_f32(a.v) }; }
+inline Lanes to_float(Bits a) { return { vcvtq_f32_s32(a.v) }; }
+inline Bits operator+(Bits a, Bits b) { return { vaddq_s32(a.v, b.v) }; }
+inline Bits operator-(Bits a, Bits b) { return { vsubq_s32(a.v, b.v) }; }
+inline Bits operator&(Bits a, Bits b) { return { vandq_s32(a.v, b.v) }; }
+inline Bits operator|(Bits a, Bits b) { return { vorrq_s32(a.v, b.v) }; }
+template<int n> inline Bits shift_left(Bits a) { return { vshlq_n_s32(a.v, n) }; }
+template<int n> inline Bits shift_right(Bits a) { return { vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a.v), n)) }; }
+inline Lanes operator==(Bits a, Bits b) { return { vreinterpretq_f32_u32(vceqq_s32(a.v, b.v)) }; }
+
+#else
+
+constexpr int lane_count = 8;
+
+struct Lanes { float v[lane_count]; };
+struct Bits { int32_t v[lane_count]; };
+
+#define LANES_MAP(type, expr) type r; for (int i = 0; i < lane_count; i++) r.v[i] = (expr); return r
+
+inline Lanes lanes(float f) { LANES_MAP(Lanes, f); }
+inline Lanes load(const float* p) { LANES_MAP(Lanes, p[i]); }
+inline void store(float* p, Lanes a) { for (int i = 0; i < lane_count; i++) p[i] = a.v[i]; }
+
+inline Bits to_bits(Lanes a) { Bits r; std::memcpy(r.v, a.v, sizeof(r.v)); return r; }
+inline Lanes from_bits(Bits a) { Lanes r; std::memcpy(r.v, a.v, sizeof(r.v)); return r; }
+inline Lanes mask(bool (&m)[lane_count]) { Bits r; for (int i = 0; i < lane_count; i++) r.v[i] = m[i] ? -1 : 0; return from_bits(r); }
+
+inline Lanes operator+(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] + b.v[i]); }
+inline Lanes operator-(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] - b.v[i]); }
+inline Lanes operator*(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] * b.v[i]); }
+inline Lanes operator/(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] / b.v[i]); }
+inline Lanes operator-(Lanes a) { LANES_MAP(Lanes, -a.v[i]); }
+inline Lanes min(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+inline Lanes max(Lanes a, Lanes b) { LANES_MAP(Lanes, a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline Lanes sqrt(Lanes a) { LANES_MAP(Lanes, std::sqrt(a.v[i])); }
+inline Lanes floor(Lanes a) { LANES_MAP(Lanes, std::floor(a.v[i])); }
+inline Lanes ceil(Lanes a) { LANES_MAP(Lanes, std::ceil(a.v[i])); }
+inline Lanes trunc(Lanes a) { LANES_MAP(Lanes, std::trunc(a.v[i])); }
+inline Lanes round(Lanes a) { LANES_MAP(Lanes, std::nearbyint(a.v[i])); }
+
+inline Lanes operator<(Lanes a, Lanes b) { bool m[lane_count]; for (int i = 0; i < lane_count; i++) m[i] = a.v[i] < b.v[i]; return mask(m); }
+inline Lanes operator<=(Lanes a, Lanes b) { bool m[lane_count]; for (int i = 0; i < lane_count; i++) m[i] = a.v[i] <= b.v[i]; return mask(m); }
+inline Lanes operator==(Lanes a, Lanes b) { bool m[lane_count]; for (int i = 0; i < lane_count; i++) m[i] = a.v[i] == b.v[i]; return mask(m); }
+inline Lanes operator&(Lanes a, Lanes b) { Bits x = to_bits(a), y = to_bits(b); for (int i = 0; i < lane_count; i++) x.v[i] &= y.v[i]; return from_bits(x); }
+inline Lanes operator|(Lanes a, Lanes b) { Bits x = to_bits(a), y = to_bits(b); for (int i = 0; i < lane_count; i++) x.v[i] |= y.v[i]; return from_bits(x); }
+inline Lanes operator~(Lanes a) { Bits x = to_bits(a); for (int i = 0; i < lane_count; i++) x.v[i] = ~x.v[i]; return from_bits(x); }
+inline Lanes select(Lanes m, Lanes a, Lanes b) { Bits k = to_bits(m); LANES_MAP(Lanes, k.v[i] ? a.v[i] : b.v[i]); }
+
+inline Bits bits(int32_t n) { LANES_MAP(Bits, n); }
+inline Bits to_int(Lanes a) { LANES_MAP(Bits, (int32_t)std::nearbyint(a.v[i])); }
+inline Lanes to_float(Bits a) { LANES_MAP(Lanes, (float)a.v[i]); }
+inline Bits operator+(Bits a, Bits b) { LANES_MAP(Bits, (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i])); }
+inline Bits operator-(Bits a, Bits b) { LANES_MAP(Bits, (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i])); }
+inline Bits operator&(Bits a, Bits b) { LANES_MAP(Bits, a.v[i] & b.v[i]); }
+inline Bits operator|(Bits a, Bits b) { LANES_MAP(Bits, a.v[i] | b.v[i]); }
+template<int n> inline Bits shift_left(Bits a) { LANES_MAP(Bits, (int32_t)((uint32_t)a.v[i] << n)); }
+template<int n> inline Bits shift_right(Bits a) { LANES_MAP(Bits, (int32_t)((uint32_t)a.v[i] >> n)); }
+inline Lanes operator==(Bits a, Bits b) { bool m[lane_count]; for (int i = 0; i < lane_count; i++) m[i] = a.v[i] == b.v[i]; return mask(m); }
+
+#undef LANES_MAP
+
+#endif
+
+// everything below is built on the primitives above
+
+inline Lanes operator+(Lanes a, float b) { return a + lanes(b); }
+inline Lanes operator-(Lanes a, float b) { return a - lanes(b); }
+inline Lanes operator*(Lanes a, float b) { return a * lanes(b); }
+inline Lanes operator+(float a, Lanes b) { return lanes(a) + b; }
+inline Lanes operator-(float a, Lanes b) { return lanes(a) - b; }
+inline Lanes operator*(float a, Lanes b) { return lanes(a) * b; }
+inline Lanes operator/(float a, Lanes b) { return lanes(a) / b; }
+inline Lanes operator>(Lanes a, Lanes b) { return b < a; }
+inline Lanes operator>=(Lanes a, Lanes b) { return b <= a; }
+inline Lanes operator!=(Lanes a, Lanes b) { return ~(a == b); }
+
+inline Lanes abs(Lanes a) { return from_bits(to_bits(a) & bits(0x7fffffff)); }
+inline Lanes sign(Lanes a) { return select(a > lanes(0.f), lanes(1.f), select(a < lanes(0.f), lanes(-1.f), lanes(0.f))); }
+
+// applies a scalar function lane by lane, for the functions without a lane approximation
+template<class F>
+inline Lanes per_lane(F f, Lanes a) {
+    float x[lane_count];
+    store(x, a);
+    for (float& v : x) v = f(v);
+    return load(x);
+}
+template<class F>
+inline Lanes per_lane(F f, Lanes a, Lanes b) {
+    float x[lane_count], y[lane_count];
+    store(x, a);
+    store(y, b);
+    for (int i = 0; i < lane_count; i++) x[i] = f(x[i], y[i]);
+    return load(x);
+}
+
+// sine of x + quadrant * pi/2; Cody-Waite reduction to [-pi/4, pi/4] and
+// the single precision minimax polynomials of Cephes
+inline Lanes sin_quadrant(Lanes x, int quadrant) {
+    Lanes q = round(x * 0.636619772f);
+    Lanes r = x - q * 1.5703125f - q * 4.837512969970703125e-4f - q * 7.54978995489188216e-8f;
+    Bits n = to_int(q) + bits(quadrant);
+    Lanes r2 = r * r;
+    Lanes s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    Lanes c = 1.f - r2 * 0.5f + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+    Lanes v = select((n & bits(1)) == bits(1), c, s);
+    return select((n & bits(2)) == bits(2), -v, v);
+}
+inline Lanes sin(Lanes x) { return sin_quadrant(x, 0); }
+inline Lanes cos(Lanes x) { return sin_quadrant(x, 1); }
+
+inline Lanes exp(Lanes x) {
+    // the scale 2^n is built in two halves so that n = 128 does not overflow the exponent field
+    Lanes c = min(max(x, lanes(-86.f)), lanes(88.72283f));
+    Lanes n = round(c * 1.44269504088896341f);
+    Lanes r = c - n * 0.693359375f + n * 2.12194440e-4f;
+    Lanes p = 1.9875691500e-4f * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    Lanes y = (r * r * p + r + 1.f) * from_bits(shift_left<23>(to_int(n) + bits(126))) * 2.f;
+    y = select(x < lanes(-87.33654f), lanes(0.f), y);
+    y = select(x > lanes(88.72283f), lanes(std::numeric_limits<float>::infinity()), y);
+    return select(x != x, x, y);
+}
+
+inline Lanes log(Lanes x) {
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), log(m) by the Cephes polynomial
+    Bits b = to_bits(x);
+    Bits e = shift_right<23>(b) - bits(126);
+    Lanes m = from_bits((b & bits(0x807fffff)) | bits(0x3f000000));
+    Lanes small = m < lanes(0.707106781186547524f);
+    e = e + to_bits(small); // a set mask is -1
+    Lanes f = select(small, m + m, m) - 1.f;
+    Lanes z = f * f;
+    Lanes p = 7.0376836292e-2f * f - 1.1514610310e-1f;
+    p = p * f + 1.1676998740e-1f;
+    p = p * f - 1.2420140846e-1f;
+    p = p * f + 1.4249322787e-1f;
+    p = p * f - 1.6668057665e-1f;
+    p = p * f + 2.0000714765e-1f;
+    p = p * f - 2.4999993993e-1f;
+    p = p * f + 3.3333331174e-1f;
+    Lanes fe = to_float(e);
+    Lanes y = p * f * z + fe * -2.12194440e-4f - z * 0.5f;
+    y = f + y + fe * 0.693359375f;
+
+    const float inf = std::numeric_limits<float>::infinity();
+    y = select(x == lanes(0.f), lanes(-inf), y);
+    y = select(x == lanes(inf), x, y);
+    return select((x < lanes(0.f)) | (x != x), lanes(std::numeric_limits<float>::quiet_NaN()), y);
+}
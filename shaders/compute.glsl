@@ -1,13 +1,23 @@
 #version 460 core
 
-layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+#define TILE 16
 
-layout(std430, binding = 0) volatile buffer gridbuffer {
-	float grid[];
+layout(local_size_x = TILE, local_size_y = TILE, local_size_z = 1) in;
+
+struct GridPoint {
+	vec4 value;  // z / zoomz, in_region, dz/dx, dz/dy
+	vec4 normal; // world-space normal of the surface
+};
+layout(std430, binding = 0) writeonly buffer gridbuffer {
+	GridPoint grid[];
 };
 layout(std430, binding = 1) readonly buffer sliderbuffer {
 	float sliders[];
 };
+// one sum per workgroup when evaluating an integrand
+layout(std430, binding = 5) writeonly buffer partialbuffer {
+	double partials[];
+};
 
 const float PI = 3.1415926535897932384626433f;
 const float e = 2.7182818284590452353602874f;
@@ -19,32 +29,77 @@ uniform float zoomz;
 uniform vec3 centerPos;
 
 uniform float plane_params[5];
+uniform bool reduce;
+uniform int group_offset; // first row of workgroups, integrals are evaluated in bands
+
+// the lattice points a grid evaluation covers; gridbuffer wraps around, so
+// a panned view only evaluates the strips that came into view
+uniform ivec2 region_size;  // in points of the stride
+uniform ivec2 region_slot;  // where its first point goes in grid
+uniform vec2 region_world;  // and where it lies
+uniform int stride;         // lattice points between evaluated ones, > 1 for a preview
+// a refinement pass skips the points of the coarser stride, which are
+// those where id + region_phase is even in both directions
+uniform bool refine;
+uniform ivec2 region_phase;
 
-float cot(float x) {
-	return 1.f / tan(x);
+shared double sums[TILE * TILE];
+
+// the helpers of dual.glsl
+%s
+
+// f with its exact partial derivatives
+vec3 f(float x, float y) {
+	%s
 }
-float sec(float x) {
-	return 1.f / cos(x);
+
+// the scalar field an integral sums and the region it sums over, at a
+// point of the graph
+float scalar_field(float x, float y, float z, float px, float py) {
+	%s
 }
-float csc(float x) {
-	return 1.f / sin(x);
+bool region(float x, float y, float z, float px, float py) {
+	%s
 }
 
-float f(float x, float y) {
-	return (%s);
+vec2 to_cartesian(ivec2 p) {
+	return vec2(zoomx, zoomy) * ((vec2(p) + 0.5f) / float(grid_res) - 0.5f) + centerPos.xy;
 }
+
 void main() {
-	float x = zoomx * ((gl_GlobalInvocationID.x - grid_res / 2.f) / grid_res) + centerPos.x;
-    float y = zoomy * ((gl_GlobalInvocationID.y - grid_res / 2.f) / grid_res) + centerPos.y;
-	float px, py;
-	if (%s) {
-		px = (f(x + 0.001f, y) - f(x - 0.001f, y)) / 0.002f;
-		py = (f(x, y + 0.001f) - f(x, y - 0.001f)) / 0.002f;
+	ivec2 group = ivec2(gl_WorkGroupID.xy) + ivec2(0, group_offset);
+	ivec2 id = group * TILE + ivec2(gl_LocalInvocationID.xy);
+	bool inside = reduce ? id.x < grid_res && id.y < grid_res : id.x < region_size.x && id.y < region_size.y;
+
+	if (!reduce && refine && ((id.x + region_phase.x) & 1) == 0 && ((id.y + region_phase.y) & 1) == 0) return;
+
+	vec2 c = reduce ? to_cartesian(id) : region_world + vec2(id * stride) * vec2(zoomx, zoomy) / float(grid_res);
+	float x = c.x;
+	float y = c.y;
+	vec3 dual = f(x, y);
+	float z = dual.x;
+	float px = dual.y;
+	float py = dual.z;
+	float val = scalar_field(x, y, z, px, py) / zoomz;
+	bool in_region = region(x, y, z, px, py);
+
+	if (!reduce) {
+		if (!inside) return;
+		ivec2 slot = region_slot + id * stride;
+		slot -= grid_res * ivec2(greaterThanEqual(slot, ivec2(grid_res)));
+		uint idx = slot.y * grid_res + slot.x;
+		grid[idx].value = vec4(val, float(in_region), px, py);
+		grid[idx].normal = vec4(normalize(vec3(px * zoomx, -zoomz, py * zoomy)), 0.f);
+		return;
 	}
-	%s float t = atan(-y, -x) + PI;
-	float z = f(x, y);
-	float val = (%s) / zoomz;
-	bool in_region = (%s);
-    grid[2 * (gl_GlobalInvocationID.y * grid_res + gl_GlobalInvocationID.x)] = val;
-	grid[2 * (gl_GlobalInvocationID.y * grid_res + gl_GlobalInvocationID.x) + 1] = float(in_region);
-}
\ No newline at end of file
+
+	// masked, NaN/Inf-filtered sum over the tile in double precision
+	uint lid = gl_LocalInvocationIndex;
+	sums[lid] = inside && in_region && !isnan(val) && !isinf(val) ? double(val) : 0.0lf;
+	barrier();
+	for (uint span = TILE * TILE / 2; span > 0; span >>= 1) {
+		if (lid < span) sums[lid] += sums[lid + span];
+		barrier();
+	}
+	if (lid == 0) partials[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = sums[0];
+}
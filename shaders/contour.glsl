@@ -0,0 +1,113 @@
+#version 460 core
+
+#define TILE 16
+#define MAX_LEVELS 64
+
+layout(local_size_x = TILE, local_size_y = TILE, local_size_z = 1) in;
+
+struct GridPoint {
+	vec4 value;
+	vec4 normal;
+};
+layout(std430, binding = 0) readonly buffer gridbuffer {
+	GridPoint grid[];
+};
+// endpoints of the segments as the lattice coordinates of the view's window
+// and the height z / zoomz, so that they are kept while the view pans within
+// a lattice cell and are placed by the line shader; w is 1 on the surface
+// and 0 for the copy on the floor
+layout(std430, binding = 14) writeonly buffer contourbuffer {
+	vec4 points[];
+};
+// DrawArraysIndirectCommand of the segments, reset to no vertices beforehand
+layout(std430, binding = 13) buffer drawbuffer {
+	uint draw_count;
+	uint draw_instances;
+	uint draw_first;
+	uint draw_base_instance;
+};
+
+uniform int grid_res;
+uniform ivec2 wrap;         // slot in grid of the first visible lattice point
+uniform int mesh_res;       // points per side of the evaluated sub-lattice, as for vertex.glsl
+uniform int mesh_stride;
+uniform ivec2 mesh_first;
+uniform float zoomz;
+uniform float levels[MAX_LEVELS]; // z of every contour
+uniform int level_count;
+uniform bool floor_copy;    // every segment again on the bottom of the box
+uniform uint max_points;    // that fit in contourbuffer
+
+// corners of a cell counter-clockwise from its first lattice point; edge k
+// runs from corner k to the next
+const ivec2 corners[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1), ivec2(0, 1));
+
+// the endpoint at lattice coordinates p and height z / zoomz
+vec3 endpoint(vec2 p, float height) {
+	vec2 t = (p + 0.5f) / float(grid_res) - 0.5f;
+	return vec3(t.x, height, t.y);
+}
+
+void emit(vec3 a, vec3 b) {
+	uint n = floor_copy ? 4 : 2;
+	uint i = atomicAdd(draw_count, n);
+	if (i + n > max_points) return;
+	points[i] = vec4(a, 1.f);
+	points[i + 1] = vec4(b, 1.f);
+	if (floor_copy) {
+		points[i + 2] = vec4(a, 0.f);
+		points[i + 3] = vec4(b, 0.f);
+	}
+}
+
+void main() {
+	ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+	if (id.x >= mesh_res - 1 || id.y >= mesh_res - 1) return;
+
+	ivec2 p[4];
+	float h[4];
+	for (int k = 0; k < 4; k++) {
+		p[k] = mesh_first + (id + corners[k]) * mesh_stride;
+		ivec2 slot = (wrap + p[k]) % grid_res;
+		vec4 value = grid[slot.y * grid_res + slot.x].value;
+		// no contours through poles or outside the graph's region
+		if (isnan(value.x) || isinf(value.x) || value.y < 0.5f) return;
+		h[k] = value.x;
+	}
+
+	for (int l = 0; l < level_count; l++) {
+		float level = levels[l] / zoomz;
+		int config = 0;
+		for (int k = 0; k < 4; k++)
+			if (h[k] >= level) config |= 1 << k;
+		if (config == 0 || config == 15) continue;
+
+		// where the level crosses every edge that changes sides
+		vec3 cross_at[4];
+		for (int k = 0; k < 4; k++) {
+			int j = (k + 1) % 4;
+			float s = (level - h[k]) / (h[j] - h[k]);
+			s = isnan(s) ? 0.5f : clamp(s, 0.f, 1.f);
+			cross_at[k] = endpoint(mix(vec2(p[k]), vec2(p[j]), s), level);
+		}
+
+		// the edges crossed; of a saddle, the corners on the side of the
+		// cell's center are joined across it
+		int crossed[4];
+		int n = 0;
+		for (int k = 0; k < 4; k++)
+			if (((config >> k) & 1) != ((config >> ((k + 1) % 4)) & 1)) crossed[n++] = k;
+		if (n == 2) emit(cross_at[crossed[0]], cross_at[crossed[1]]);
+		else {
+			bool center_above = 0.25f * (h[0] + h[1] + h[2] + h[3]) >= level;
+			if (center_above == ((config & 1) != 0)) {
+				emit(cross_at[0], cross_at[1]);
+				emit(cross_at[2], cross_at[3]);
+			}
+			else {
+				emit(cross_at[3], cross_at[0]);
+				emit(cross_at[1], cross_at[2]);
+			}
+		}
+	}
+}
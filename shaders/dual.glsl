@@ -0,0 +1,153 @@
+// included by compute.glsl, parametric.glsl and marchingcubes.glsl where
+// they have a %s for it: the functions of the expression language GLSL lacks, and dual numbers
+// vec3(u, du/dx, du/dy) for forward-mode differentiation of a definition
+
+float cot(float x) {
+	return 1.f / tan(x);
+}
+float sec(float x) {
+	return 1.f / cos(x);
+}
+float csc(float x) {
+	return 1.f / sin(x);
+}
+
+vec3 d_mul(vec3 a, vec3 b) {
+	return vec3(a.x * b.x, a.x * b.yz + b.x * a.yz);
+}
+vec3 d_div(vec3 a, vec3 b) {
+	return vec3(a.x / b.x, (a.yz * b.x - a.x * b.yz) / (b.x * b.x));
+}
+vec3 d_sin(vec3 a) {
+	return vec3(sin(a.x), cos(a.x) * a.yz);
+}
+vec3 d_cos(vec3 a) {
+	return vec3(cos(a.x), -sin(a.x) * a.yz);
+}
+vec3 d_tan(vec3 a) {
+	float t = tan(a.x);
+	return vec3(t, (1.f + t * t) * a.yz);
+}
+vec3 d_cot(vec3 a) {
+	float c = cot(a.x);
+	return vec3(c, -(1.f + c * c) * a.yz);
+}
+vec3 d_sec(vec3 a) {
+	float s = sec(a.x);
+	return vec3(s, s * tan(a.x) * a.yz);
+}
+vec3 d_csc(vec3 a) {
+	float c = csc(a.x);
+	return vec3(c, -c * cot(a.x) * a.yz);
+}
+vec3 d_asin(vec3 a) {
+	return vec3(asin(a.x), inversesqrt(1.f - a.x * a.x) * a.yz);
+}
+vec3 d_acos(vec3 a) {
+	return vec3(acos(a.x), -inversesqrt(1.f - a.x * a.x) * a.yz);
+}
+vec3 d_atan(vec3 a) {
+	return vec3(atan(a.x), a.yz / (1.f + a.x * a.x));
+}
+vec3 d_atan(vec3 a, vec3 b) {
+	return vec3(atan(a.x, b.x), (b.x * a.yz - a.x * b.yz) / (a.x * a.x + b.x * b.x));
+}
+vec3 d_sinh(vec3 a) {
+	return vec3(sinh(a.x), cosh(a.x) * a.yz);
+}
+vec3 d_cosh(vec3 a) {
+	return vec3(cosh(a.x), sinh(a.x) * a.yz);
+}
+vec3 d_tanh(vec3 a) {
+	float t = tanh(a.x);
+	return vec3(t, (1.f - t * t) * a.yz);
+}
+vec3 d_asinh(vec3 a) {
+	return vec3(asinh(a.x), inversesqrt(a.x * a.x + 1.f) * a.yz);
+}
+vec3 d_acosh(vec3 a) {
+	return vec3(acosh(a.x), inversesqrt(a.x * a.x - 1.f) * a.yz);
+}
+vec3 d_atanh(vec3 a) {
+	return vec3(atanh(a.x), a.yz / (1.f - a.x * a.x));
+}
+vec3 d_exp(vec3 a) {
+	float v = exp(a.x);
+	return vec3(v, v * a.yz);
+}
+vec3 d_exp2(vec3 a) {
+	float v = exp2(a.x);
+	return vec3(v, v * log(2.f) * a.yz);
+}
+vec3 d_log(vec3 a) {
+	return vec3(log(a.x), a.yz / a.x);
+}
+vec3 d_log2(vec3 a) {
+	return vec3(log2(a.x), a.yz / (a.x * log(2.f)));
+}
+vec3 d_sqrt(vec3 a) {
+	float v = sqrt(a.x);
+	return vec3(v, a.yz / (2.f * v));
+}
+vec3 d_inversesqrt(vec3 a) {
+	float v = inversesqrt(a.x);
+	return vec3(v, -0.5f * v / a.x * a.yz);
+}
+vec3 d_abs(vec3 a) {
+	return vec3(abs(a.x), sign(a.x) * a.yz);
+}
+vec3 d_sign(vec3 a) {
+	return vec3(sign(a.x), vec2(0.f));
+}
+vec3 d_floor(vec3 a) {
+	return vec3(floor(a.x), vec2(0.f));
+}
+vec3 d_ceil(vec3 a) {
+	return vec3(ceil(a.x), vec2(0.f));
+}
+vec3 d_round(vec3 a) {
+	return vec3(round(a.x), vec2(0.f));
+}
+vec3 d_trunc(vec3 a) {
+	return vec3(trunc(a.x), vec2(0.f));
+}
+vec3 d_fract(vec3 a) {
+	return vec3(fract(a.x), a.yz);
+}
+vec3 d_radians(vec3 a) {
+	return radians(a);
+}
+vec3 d_degrees(vec3 a) {
+	return degrees(a);
+}
+vec3 d_pow(vec3 a, vec3 b) {
+	float v = pow(a.x, b.x);
+	// the log term only where the exponent varies, so that it adds no NaN of
+	// its own for a < 0; pow itself is undefined there, only the small integer
+	// powers Expression::power expands into products are defined for a < 0
+	vec2 d = b.x * pow(a.x, b.x - 1.f) * a.yz;
+	if (b.yz != vec2(0.f)) d += v * log(a.x) * b.yz;
+	return vec3(v, d);
+}
+vec3 d_mod(vec3 a, vec3 b) {
+	return vec3(mod(a.x, b.x), a.yz - floor(a.x / b.x) * b.yz);
+}
+vec3 d_min(vec3 a, vec3 b) {
+	return a.x <= b.x ? a : b;
+}
+vec3 d_max(vec3 a, vec3 b) {
+	return a.x >= b.x ? a : b;
+}
+vec3 d_step(vec3 a, vec3 b) {
+	return vec3(step(a.x, b.x), vec2(0.f));
+}
+vec3 d_clamp(vec3 a, vec3 b, vec3 c) {
+	return d_min(d_max(a, b), c);
+}
+vec3 d_mix(vec3 a, vec3 b, vec3 c) {
+	return vec3(mix(a.x, b.x, c.x), mix(a.yz, b.yz, c.x) + (b.x - a.x) * c.yz);
+}
+vec3 d_smoothstep(vec3 a, vec3 b, vec3 c) {
+	vec3 t = d_clamp(d_div(c - a, b - a), vec3(0.f), vec3(1.f, 0.f, 0.f));
+	return vec3(t.x * t.x * (3.f - 2.f * t.x), 6.f * t.x * (1.f - t.x) * t.yz);
+}
@@ -1,18 +1,18 @@
 #version 460 core
 
-out vec4 fragColor;
+layout(location = 0) out vec4 fragColor;
+// graph index in the top 8 bits of x, grid coordinates as 24 bit fractions
+// of the visible extent, or of the (u, v) lattice of a parametric surface,
+// in the rest of x and in y
+layout(location = 1) out uvec2 pickId;
 
-layout(std430, binding = 1) volatile buffer posbuffer {
-	float posbuf[];
-};
-layout(std430, binding = 2) readonly buffer kernel {
-    float weights[];
-};
-uniform int radius;
+uniform float scale; // of the supersampled frame to the window, not necessarily whole
 
 in vec3 normal;
 in vec3 fragPos;
 in vec2 gridCoord;
+in vec2 gradient; // exact dz/dx and dz/dy from the grid
+in vec2 pickCoord;
 flat in float inRegion;
 
 uniform float ambientStrength;
@@ -41,36 +41,117 @@ uniform vec2 corner2;
 uniform int integrand_idx;
 
 uniform bool quad;
+uniform int resolve;       // ResolvePass of the quad pass
+uniform bool history_valid;
+uniform mat4 reprojection; // from this frame's unjittered clip space to the history's
+uniform vec2 jitter;       // of this frame, in clip space
 layout(binding = 0) uniform sampler2D frameTex;
-layout(binding = 1) uniform sampler2D prevZBuffer;
+layout(binding = 2) uniform sampler2D historyTex;
+layout(binding = 3) uniform sampler2D depthTex;
+
+// ResolvePass in main.cpp
+const int ResolveCopy = 0;
+const int ResolveHorizontal = 1;
+const int ResolveVertical = 2;
+const int ResolveFXAA = 3;
+const int ResolveTAA = 4;
+
+// one dimension of the Gaussian downsample, sigma half a window pixel;
+// the horizontal pass reads whole frame rows, the vertical one its output
+vec3 downsample(vec2 axis) {
+	vec2 size = vec2(textureSize(frameTex, 0));
+	vec2 center = mix(gl_FragCoord.xy, gl_FragCoord.xy * scale, axis);
+	int r = int(ceil(scale));
+	float sigma = scale / 2.f;
+	vec3 sum = vec3(0.f);
+	float total = 0.f;
+	for (int i = -r; i <= r; i++) {
+		vec2 texel = mix(center, floor(center) + i + 0.5f, axis);
+		float d = dot(texel - center, axis);
+		float w = exp(-0.5f * d * d / (sigma * sigma));
+		sum += w * texture(frameTex, texel / size).rgb;
+		total += w;
+	}
+	return sum / total;
+}
+
+float luma(vec3 rgb) {
+	return dot(rgb, vec3(0.299f, 0.587f, 0.114f));
+}
+
+// FXAA: blends along the local edge direction found from the luma of the corners
+vec3 fxaa() {
+	vec2 texel = 1.f / vec2(textureSize(frameTex, 0));
+	vec2 uv = gl_FragCoord.xy * texel;
+	vec3 rgbM = texture(frameTex, uv).rgb;
+	float lumaNW = luma(texture(frameTex, uv + vec2(-0.5f, 0.5f) * texel).rgb);
+	float lumaNE = luma(texture(frameTex, uv + vec2(0.5f, 0.5f) * texel).rgb);
+	float lumaSW = luma(texture(frameTex, uv + vec2(-0.5f, -0.5f) * texel).rgb);
+	float lumaSE = luma(texture(frameTex, uv + vec2(0.5f, -0.5f) * texel).rgb);
+	float lumaM = luma(rgbM);
+	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+	float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+	if (lumaMax - lumaMin < max(0.0625f, lumaMax * 0.125f)) return rgbM;
+
+	vec2 dir = vec2((lumaSW + lumaSE) - (lumaNW + lumaNE), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+	float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25f * 0.125f, 1.f / 128.f);
+	float scaleDir = 1.f / (min(abs(dir.x), abs(dir.y)) + reduce);
+	dir = clamp(dir * scaleDir, vec2(-8.f), vec2(8.f)) * texel;
+
+	vec3 rgbA = 0.5f * (texture(frameTex, uv - dir / 6.f).rgb + texture(frameTex, uv + dir / 6.f).rgb);
+	vec3 rgbB = 0.5f * rgbA + 0.25f * (texture(frameTex, uv - dir / 2.f).rgb + texture(frameTex, uv + dir / 2.f).rgb);
+	float lumaB = luma(rgbB);
+	return lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB;
+}
+
+// blends this frame into the history at where its surface was last frame,
+// the history clamped to the colors around the pixel so what was disoccluded
+// does not ghost. Alpha counts the frames accumulated, up to 16
+vec4 temporal() {
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(frameTex, 0);
+	vec3 current = texelFetch(frameTex, p, 0).rgb;
+	vec3 lo = current, hi = current;
+	for (int i = -1; i <= 1; i++) {
+		for (int j = -1; j <= 1; j++) {
+			vec3 c = texelFetch(frameTex, clamp(p + ivec2(i, j), ivec2(0), size - 1), 0).rgb;
+			lo = min(lo, c);
+			hi = max(hi, c);
+		}
+	}
+	vec2 offset = vec2(windowSize.x - regionSize.x, 0.f);
+	vec2 ndc = (gl_FragCoord.xy - offset) / regionSize * 2.f - 1.f - jitter;
+	vec4 prev = reprojection * vec4(ndc, texelFetch(depthTex, p, 0).r * 2.f - 1.f, 1.f);
+	prev /= prev.w;
+	if (!history_valid || any(greaterThan(abs(prev.xy), vec2(1.f)))) return vec4(current, 1.f);
+
+	vec4 history = texture(historyTex, ((prev.xy * 0.5f + 0.5f) * regionSize + offset) / vec2(textureSize(historyTex, 0)));
+	float count = min(history.a + 1.f, 16.f);
+	return vec4(mix(clamp(history.rgb, lo, hi), current, 1.f / count), count);
+}
+
+vec3 resolved() {
+	switch (resolve) {
+	case ResolveHorizontal: return downsample(vec2(1.f, 0.f));
+	case ResolveVertical: return downsample(vec2(0.f, 1.f));
+	case ResolveFXAA: return fxaa();
+	}
+	return texture(frameTex, gl_FragCoord.xy / vec2(textureSize(frameTex, 0))).rgb;
+}
 
 void main() {
 	if (quad) {
-		if (radius > 1) {
-			vec3 blurredColor = vec3(0.0);
-			int kernelSize = 2 * radius + 1;
-			for (int i = -radius; i <= radius; i++) {
-				for (int j = -radius; j <= radius; j++) {
-					vec3 c = texture(frameTex, (gl_FragCoord.xy * radius + vec2(i, j)) / windowSize).rgb;
-					blurredColor += c * weights[(i + radius) * kernelSize + (j + radius)];
-				}
-			}
-			fragColor = vec4(blurredColor, 1.f);
-		} else {
-			fragColor = vec4(texture(frameTex, gl_FragCoord.xy / windowSize).rgb, 1.f);
-		}
+		fragColor = resolve == ResolveTAA ? temporal() : vec4(resolved(), 1.f);
 		return;
 	}
 	float z = fragPos.y * zoomz / graph_size;
 	vec3 normalvec = normal * (int(!gl_FrontFacing) * 2 - 1);
-	float partialx = 1.f / tan(acos(dot(vec3(1, 0, 0), normalize(dot(normal, vec3(1, 0, 0)) * vec3(1, 0, 0) + dot(normal, vec3(0, 1, 0)) * vec3(0, 1, 0)))));
-	float partialy = 1.f / tan(acos(dot(vec3(0, 0, 1), normalize(dot(normal, vec3(0, 0, 1)) * vec3(0, 0, 1) + dot(normal, vec3(0, 1, 0)) * vec3(0, 1, 0)))));
-	vec2 gradient = vec2(partialx, partialy);
+	float partialx = gradient.x;
+	float partialy = gradient.y;
 
 	vec2 zrange = vec2(zoomz / 2.f, -zoomz / 2.f) + centerPos.z;
-	vec3 grad3d = vec3(gradient, partialx * partialx + partialy * partialy);
-	float angle = acos(length(gradient) / length(grad3d));
-	if (isinf(length(gradient))) angle = 1.57079632f;
+	// inclination of the surface
+	float angle = atan(length(gradient));
 	
 	switch (coloring) {
 	case 0:
@@ -131,18 +212,8 @@ void main() {
 		}
 	}
 
-	float prevDepth = texture(prevZBuffer, (gl_FragCoord.xy) / windowSize).r;
-	if (!tangent_plane && int(gl_FragCoord.x) % radius == 0 && int(gl_FragCoord.y) % radius == 0 && gl_FragCoord.z == prevDepth) {
-		if (bool(integral) && index != integrand_idx) return;
-		float x = floor((gl_FragCoord.x - windowSize.x + regionSize.x) / radius);
-		float y = floor(gl_FragCoord.y / radius);
-		float w = floor(regionSize.x / radius);
-		y = floor(regionSize.y / radius) - y;
-		posbuf[6 * int(w * y + x) + 0] = gridCoord.x;
-		posbuf[6 * int(w * y + x) + 1] = gridCoord.y;
-		posbuf[6 * int(w * y + x) + 2] = z;
-		posbuf[6 * int(w * y + x) + 3] = float(index);
-		posbuf[6 * int(w * y + x) + 4] = partialx;
-		posbuf[6 * int(w * y + x) + 5] = partialy;
-	}
+	vec2 uv = clamp(pickCoord, 0.f, 1.f);
+	uvec2 fraction = uvec2(round(uv * 16777215.f));
+	// the graph index is split over the spare top bytes of both channels
+	pickId = uvec2(uint(index) << 24 | fraction.x, (uint(index) >> 8) << 24 | fraction.y);
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#version 460 core
+
+// every pass runs 256 invocations per workgroup over a linear range, with
+// the workgroups spread over two dimensions past the dispatch limit
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+// F at the (volume_res + 1)^3 lattice points over the view, x fastest
+layout(std430, binding = 0) buffer gridbuffer {
+	float density[];
+};
+layout(std430, binding = 1) readonly buffer sliderbuffer {
+	float sliders[];
+};
+// the triang table of main.cpp, 15 edges per configuration ending with -1
+layout(std430, binding = 10) readonly buffer tablebuffer {
+	int triang[];
+};
+// triangles of every cell, then exclusive prefix sums of them; the block
+// totals of every level follow the level, the grand total comes last
+layout(std430, binding = 11) buffer scanbuffer {
+	uint scan[];
+};
+struct MeshVertex {
+	vec4 position; // x, y, z, dz/dx
+	vec4 normal;   // world-space normal, dz/dy
+};
+layout(std430, binding = 12) writeonly buffer meshbuffer {
+	MeshVertex vertices[];
+};
+// DrawArraysIndirectCommand of the emitted triangles
+layout(std430, binding = 13) writeonly buffer drawbuffer {
+	uint draw_count;
+	uint draw_instances;
+	uint draw_first;
+	uint draw_base_instance;
+};
+
+const float PI = 3.1415926535897932384626433f;
+const float e = 2.7182818284590452353602874f;
+
+// MarchingCubesPass in main.cpp
+const int SampleVolume = 0;
+const int ClassifyCells = 1;
+const int ScanBlocks = 2;
+const int AddBlockOffsets = 3;
+const int EmitTriangles = 4;
+const uint block = 1024; // elements per workgroup of a scan
+
+uniform int pass;
+uniform int volume_res;     // cells per side
+uniform float zoomx;
+uniform float zoomy;
+uniform float zoomz;
+uniform vec3 centerPos;
+uniform uint max_triangles; // that fit in meshbuffer
+uniform uint level_offset;  // first element in scan of the level being scanned
+uniform uint level_size;
+uniform uint next_offset;   // where its block totals go
+uniform bool last_level;    // a single block, whose total is the triangle count
+
+// corners of a cell and the edges between them, in the order of triang
+const ivec3 corners[8] = ivec3[](ivec3(0, 0, 0), ivec3(1, 0, 0), ivec3(1, 1, 0), ivec3(0, 1, 0), ivec3(0, 0, 1), ivec3(1, 0, 1), ivec3(1, 1, 1), ivec3(0, 1, 1));
+const ivec2 edges[12] = ivec2[](ivec2(0, 1), ivec2(1, 2), ivec2(2, 3), ivec2(3, 0), ivec2(4, 5), ivec2(5, 6), ivec2(6, 7), ivec2(7, 4), ivec2(0, 4), ivec2(1, 5), ivec2(2, 6), ivec2(3, 7));
+
+shared uint partial[256];
+
+// the helpers of dual.glsl
+%s
+
+// left minus right side of the equation
+float F(float x, float y, float z) {
+	%s
+}
+
+uint group_index() {
+	return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
+
+ivec3 unravel(uint i, int n) {
+	return ivec3(i - i / n * n, i / n - i / (n * n) * n, i / (n * n));
+}
+
+float sample_at(ivec3 p) {
+	int n = volume_res + 1;
+	p = clamp(p, ivec3(0), ivec3(volume_res));
+	return density[(p.z * n + p.y) * n + p.x];
+}
+
+vec3 to_cartesian(vec3 p) {
+	return vec3(zoomx, zoomy, zoomz) * (p / float(volume_res) - 0.5f) + centerPos;
+}
+
+// central differences, one-sided on the faces of the volume; a step is
+// as long in world space along every axis, so this is F's gradient there
+// up to scale, with y and z swapped
+vec3 lattice_gradient(ivec3 p) {
+	return vec3(
+		sample_at(p + ivec3(1, 0, 0)) - sample_at(p - ivec3(1, 0, 0)),
+		sample_at(p + ivec3(0, 1, 0)) - sample_at(p - ivec3(0, 1, 0)),
+		sample_at(p + ivec3(0, 0, 1)) - sample_at(p - ivec3(0, 0, 1)));
+}
+
+// configuration of the cell, a bit per corner inside F < 0, or 0 when F
+// is undefined at a corner so that no triangles bridge a pole
+int configuration(ivec3 c, out float values[8]) {
+	int config = 0;
+	for (int i = 0; i < 8; i++) {
+		values[i] = sample_at(c + corners[i]);
+		if (isnan(values[i]) || isinf(values[i])) return 0;
+		if (values[i] < 0.f) config |= 1 << i;
+	}
+	return config;
+}
+
+int triangle_count(int config) {
+	int n = 0;
+	while (n < 5 && triang[config * 15 + n * 3] != -1) n++;
+	return n;
+}
+
+MeshVertex edge_vertex(ivec3 c, int edge, float values[8]) {
+	int a = edges[edge].x, b = edges[edge].y;
+	float s = values[a] / (values[a] - values[b]);
+	if (isnan(s) || isinf(s)) s = 0.5f;
+	s = clamp(s, 0.f, 1.f);
+	vec3 p = mix(vec3(c + corners[a]), vec3(c + corners[b]), s);
+	vec3 g = mix(lattice_gradient(c + corners[a]), lattice_gradient(c + corners[b]), s);
+	vec3 world = vec3(g.x, g.z, g.y);
+	// facing like the normals compute.glsl writes, which is down for F = z - f(x, y)
+	vec3 normal = length(world) > 0.f ? -normalize(world) : vec3(0.f, -1.f, 0.f);
+
+	MeshVertex v;
+	v.position = vec4(to_cartesian(p), -g.x * zoomz / (g.z * zoomx));
+	v.normal = vec4(normal, -g.y * zoomz / (g.z * zoomy));
+	return v;
+}
+
+void main() {
+	uint id = group_index() * 256 + gl_LocalInvocationIndex;
+	uint cells = uint(volume_res * volume_res * volume_res);
+
+	if (pass == SampleVolume) {
+		int n = volume_res + 1;
+		if (id >= uint(n * n * n)) return;
+		vec3 c = to_cartesian(vec3(unravel(id, n)));
+		density[id] = F(c.x, c.y, c.z);
+	}
+	else if (pass == ClassifyCells) {
+		if (id >= cells) return;
+		float values[8];
+		scan[id] = uint(triangle_count(configuration(unravel(id, volume_res), values)));
+	}
+	else if (pass == ScanBlocks) {
+		// whole workgroups leave together, the rest meet at every barrier
+		uint group = group_index();
+		if (group * block >= level_size) return;
+		uint lid = gl_LocalInvocationIndex;
+		uint first = group * block + lid * 4;
+		uint values[4];
+		uint sum = 0;
+		for (int k = 0; k < 4; k++) {
+			uint v = first + k < level_size ? scan[level_offset + first + k] : 0;
+			values[k] = sum;
+			sum += v;
+		}
+		partial[lid] = sum;
+		barrier();
+		for (uint d = 1; d < 256; d <<= 1) {
+			uint v = lid >= d ? partial[lid - d] : 0;
+			barrier();
+			partial[lid] += v;
+			barrier();
+		}
+		uint before = partial[lid] - sum;
+		for (int k = 0; k < 4; k++)
+			if (first + k < level_size) scan[level_offset + first + k] = values[k] + before;
+		if (lid == 255) {
+			scan[next_offset + group] = partial[255];
+			if (last_level) {
+				draw_count = min(partial[255], max_triangles) * 3;
+				draw_instances = 1;
+				draw_first = 0;
+				draw_base_instance = 0;
+			}
+		}
+	}
+	else if (pass == AddBlockOffsets) {
+		if (id >= level_size) return;
+		scan[level_offset + id] += scan[next_offset + id / block];
+	}
+	else if (pass == EmitTriangles) {
+		if (id >= cells) return;
+		ivec3 c = unravel(id, volume_res);
+		float values[8];
+		int config = configuration(c, values);
+		int n = triangle_count(config);
+		uint first = scan[id];
+		for (int t = 0; t < n && first + t < max_triangles; t++) {
+			MeshVertex v0 = edge_vertex(c, triang[config * 15 + t * 3], values);
+			MeshVertex v1 = edge_vertex(c, triang[config * 15 + t * 3 + 1], values);
+			MeshVertex v2 = edge_vertex(c, triang[config * 15 + t * 3 + 2], values);
+			// wound like the graphs of compute.glsl, counter-clockwise around the normal
+			vec3 scale = vec3(1.f / zoomx, 1.f / zoomz, 1.f / zoomy);
+			vec3 a = (v1.position.xzy - v0.position.xzy) * scale, b = (v2.position.xzy - v0.position.xzy) * scale;
+			if (dot(cross(a, b), v0.normal.xyz + v1.normal.xyz + v2.normal.xyz) < 0.f) {
+				MeshVertex v = v1;
+				v1 = v2;
+				v2 = v;
+			}
+			uint i = (first + t) * 3;
+			vertices[i] = v0;
+			vertices[i + 1] = v1;
+			vertices[i + 2] = v2;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#version 460 core
+
+#define TILE 16
+
+layout(local_size_x = TILE, local_size_y = TILE, local_size_z = 1) in;
+
+struct GridPoint {
+	vec4 value;  // x, y, z, dz/dx
+	vec4 normal; // world-space normal of the surface, dz/dy
+};
+layout(std430, binding = 0) writeonly buffer gridbuffer {
+	GridPoint grid[];
+};
+layout(std430, binding = 1) readonly buffer sliderbuffer {
+	float sliders[];
+};
+
+const float PI = 3.1415926535897932384626433f;
+const float e = 2.7182818284590452353602874f;
+const float max_slope = 1e6f;  // of a vertical surface
+
+uniform int grid_res;
+uniform float zoomx;
+uniform float zoomy;
+uniform float zoomz;
+uniform vec2 u_range;
+uniform vec2 v_range;
+
+uniform float plane_params[5];
+
+// the lattice points an evaluation covers, as for compute.glsl; the lattice
+// is over (u, v) and never pans, so slots are lattice indices
+uniform ivec2 region_size;  // in points of the stride
+uniform ivec2 region_slot;  // where its first point goes in grid
+uniform int stride;         // lattice points between evaluated ones, > 1 for a preview
+uniform bool refine;
+uniform ivec2 region_phase;
+
+// the helpers of dual.glsl
+%s
+
+// the components with their exact partial derivatives by u and v
+vec3 X(float u, float v) {
+	%s
+}
+vec3 Y(float u, float v) {
+	%s
+}
+vec3 Z(float u, float v) {
+	%s
+}
+
+void main() {
+	ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+	if (id.x >= region_size.x || id.y >= region_size.y) return;
+	if (refine && ((id.x + region_phase.x) & 1) == 0 && ((id.y + region_phase.y) & 1) == 0) return;
+
+	// the first and last lattice points are on the ends of the ranges, closing the seams
+	ivec2 slot = region_slot + id * stride;
+	vec2 s = vec2(slot) / float(grid_res - 1);
+	float u = mix(u_range.x, u_range.y, s.x);
+	float v = mix(v_range.x, v_range.y, s.y);
+	vec3 x = X(u, v), y = Y(u, v), z = Z(u, v);
+
+	// the tangents in world space, where the view's box is a cube, give the
+	// normal; facing like the normals compute.glsl writes for r = (u, v, f(u, v))
+	vec3 ru = vec3(x.y, y.y, z.y), rv = vec3(x.z, y.z, z.z);
+	vec3 scale = vec3(1.f / zoomx, 1.f / zoomz, 1.f / zoomy);
+	vec3 normal = normalize(cross(ru.xzy * scale, rv.xzy * scale));
+	// and the slope of the surface where it is a graph over x and y. Where it
+	// is vertical, or degenerate as at a pole, n.z is kept far enough from 0
+	// that the slopes stay within max_slope rather than infinite
+	vec3 n = cross(ru, rv);
+	float bound = max(length(n) / max_slope, 1e-30f);
+	float nz = abs(n.z) >= bound ? n.z : (n.z < 0.f ? -bound : bound);
+
+	uint idx = slot.y * grid_res + slot.x;
+	grid[idx].value = vec4(x.x, y.x, z.x, -n.x / nz);
+	grid[idx].normal = vec4(normal, -n.y / nz);
+}
@@ -0,0 +1,71 @@
+#version 460 core
+
+layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+struct GridPoint {
+	vec4 value;
+	vec4 normal;
+};
+layout(std430, binding = 0) readonly buffer gridbuffer {
+	GridPoint grid[];
+};
+// node errors of every level of the Quadtree in quadtree.hpp, finest first
+layout(std430, binding = 8) buffer errorbuffer {
+	float errors[];
+};
+
+uniform int grid_res;
+uniform ivec2 wrap;         // slot in grid of the first visible lattice point
+uniform int level;          // nodes span 1 << level cells
+uniform int level_res;      // nodes per side
+uniform int level_offset;
+uniform int child_res;      // of level - 1, when level > 1
+uniform int child_offset;
+
+const float forced = 1e30f; // always split
+
+vec2 point(ivec2 p) {
+	ivec2 slot = (wrap + p) % grid_res;
+	return grid[slot.y * grid_res + slot.x].value.xy;
+}
+
+void main() {
+	ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+	if (id.x >= level_res || id.y >= level_res) return;
+	int size = 1 << level;
+	int h = size / 2;
+	ivec2 p = id * size;
+	float error = forced;
+
+	if (p.x + size <= grid_res - 1 && p.y + size <= grid_res - 1) {
+		vec2 c00 = point(p), c10 = point(p + ivec2(size, 0));
+		vec2 c01 = point(p + ivec2(0, size)), c11 = point(p + ivec2(size));
+		// the points a split adds, against the bilinear patch of the corners
+		vec2 m[5] = vec2[](point(p + ivec2(h, 0)), point(p + ivec2(size, h)), point(p + ivec2(h, size)), point(p + ivec2(0, h)), point(p + ivec2(h)));
+		float bilinear[5] = float[]((c00.x + c10.x) / 2.f, (c10.x + c11.x) / 2.f, (c01.x + c11.x) / 2.f, (c00.x + c01.x) / 2.f, (c00.x + c10.x + c01.x + c11.x) / 4.f);
+		vec4 corners = vec4(c00.x, c10.x, c01.x, c11.x);
+		vec4 regions = vec4(c00.y, c10.y, c01.y, c11.y);
+
+		int undefined = 0;
+		for (int i = 0; i < 4; i++)
+			undefined += int(isnan(corners[i]) || isinf(corners[i]));
+		bool region_edge = any(notEqual(regions, vec4(c00.y)));
+		error = 0.f;
+		for (int i = 0; i < 5; i++) {
+			error = max(error, abs(m[i].x - bilinear[i]));
+			undefined += int(isnan(m[i].x) || isinf(m[i].x));
+			region_edge = region_edge || m[i].y != c00.y;
+		}
+		// split along the edges of holes and of the integration region, not inside holes
+		if (undefined == 9) error = 0.f;
+		else if (undefined > 0 || region_edge) error = forced;
+
+		if (level > 1) {
+			ivec2 c = 2 * id;
+			error = max(error, max(
+				max(errors[child_offset + c.y * child_res + c.x], errors[child_offset + c.y * child_res + c.x + 1]),
+				max(errors[child_offset + (c.y + 1) * child_res + c.x], errors[child_offset + (c.y + 1) * child_res + c.x + 1])));
+		}
+	}
+	errors[level_offset + id.y * level_res + id.x] = error;
+}
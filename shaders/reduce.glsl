@@ -0,0 +1,34 @@
+#version 460 core
+
+#define GROUP 256
+
+layout(local_size_x = GROUP, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, binding = 5) readonly buffer inbuffer {
+	double values[];
+};
+layout(std430, binding = 7) writeonly buffer outbuffer {
+	double sums[];
+};
+
+uniform uint count;
+
+shared double partial[GROUP];
+
+// one pass of the integral reduction: every workgroup sums 2 * GROUP
+// consecutive values, the host ping-pongs passes until one value is left
+void main() {
+	uint lid = gl_LocalInvocationID.x;
+	uint i = gl_WorkGroupID.x * 2 * GROUP + lid;
+	double s = 0.0lf;
+	if (i < count) s += values[i];
+	if (i + GROUP < count) s += values[i + GROUP];
+	partial[lid] = s;
+	barrier();
+
+	for (uint stride = GROUP / 2; stride > 0; stride >>= 1) {
+		if (lid < stride) partial[lid] += partial[lid + stride];
+		barrier();
+	}
+	if (lid == 0) sums[gl_WorkGroupID.x] = partial[0];
+}
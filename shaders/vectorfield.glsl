@@ -0,0 +1,73 @@
+#version 460 core
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+struct GridPoint {
+	vec4 value;
+	vec4 normal;
+};
+layout(std430, binding = 0) readonly buffer gridbuffer {
+	GridPoint grid[];
+};
+// per instance attributes of the arrow mesh, VectorInstance in main.cpp
+struct Arrow {
+	mat4 model;
+	vec4 shape;
+	vec4 color;
+};
+layout(std430, binding = 9) writeonly buffer fieldbuffer {
+	Arrow arrows[];
+};
+
+uniform int grid_res;
+uniform ivec2 wrap;         // slot in grid of the first visible lattice point
+uniform vec2 lattice_shift; // of the world-snapped lattice from the view
+uniform int mesh_res;       // points per side of the evaluated sub-lattice, as for vertex.glsl
+uniform int mesh_stride;
+uniform ivec2 mesh_first;
+uniform int field_res;      // arrows per side
+uniform float zoomx;
+uniform float zoomy;
+uniform float zoomz;
+uniform float graph_size;
+uniform vec3 centerPos;
+uniform vec4 color;
+uniform vec4 secondary_color;
+
+void main() {
+	ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+	if (id.x >= field_res || id.y >= field_res) return;
+	Arrow arrow;
+	arrow.shape = vec4(0.f);
+	arrow.color = color;
+
+	// the evaluated lattice point nearest the center of this arrow's cell;
+	// while the grid is previewed only every mesh_stride-th one is
+	vec2 center = (vec2(id) + 0.5f) * float(grid_res) / float(field_res) - 0.5f;
+	ivec2 k = clamp(ivec2(round((center - vec2(mesh_first)) / float(mesh_stride))), 0, mesh_res - 1);
+	ivec2 p = mesh_first + k * mesh_stride;
+	ivec2 slot = (wrap + p) % grid_res;
+	GridPoint g = grid[slot.y * grid_res + slot.x];
+	vec2 t = (vec2(p) + 0.5f) / float(grid_res) - 0.5f + lattice_shift;
+	vec3 pos = vec3(graph_size * t.x, graph_size * (g.value.x - centerPos.z / zoomz), graph_size * t.y);
+
+	// the gradient in the plane of the domain, as drawn
+	vec3 v = vec3(g.value.z / zoomx, 0.f, g.value.w / zoomy) * graph_size;
+	float m = length(g.value.zw) * zoomx / zoomz;
+	bool defined = !any(isnan(g.value)) && !any(isinf(g.value)) && abs(g.value.x - centerPos.z / zoomz) <= 0.5f;
+	if (defined && m > 1e-6f && length(v) > 0.f) {
+		// magnitude saturates into the length, up to most of a cell, and into the color
+		float s = m / (1.f + m);
+		float spacing = graph_size / float(field_res);
+		float len = 0.9f * spacing * s;
+		arrow.shape = vec4(len, 0.35f * len, 0.04f * spacing, 0.12f * spacing);
+		arrow.color = mix(color, secondary_color, s);
+
+		vec3 y = normalize(v);
+		vec3 x = normalize(cross(y, vec3(0.f, 1.f, 0.f)));
+		vec3 z = cross(x, y);
+		arrow.model = mat4(vec4(x, 0.f), vec4(y, 0.f), vec4(z, 0.f), vec4(pos, 1.f));
+	}
+	else arrow.model = mat4(1.f);
+	arrows[id.y * field_res + id.x] = arrow;
+}
@@ -1,7 +1,19 @@
 #version 460 core
 
-layout(std430, binding = 0) volatile buffer gridbuffer {
-	float grid[];
+struct GridPoint {
+	vec4 value;
+	vec4 normal;
+};
+layout(std430, binding = 0) readonly buffer gridbuffer {
+	GridPoint grid[];
+};
+// triangles of an implicit surface, written by marchingcubes.glsl
+struct MeshVertex {
+	vec4 position; // x, y, z, dz/dx
+	vec4 normal;   // world-space normal, dz/dy
+};
+layout(std430, binding = 12) readonly buffer meshbuffer {
+	MeshVertex vertices[];
 };
 
 in vec3 aPos;
@@ -13,35 +25,80 @@ uniform float zoomy;
 uniform float zoomz;
 uniform float graph_size;
 uniform vec3 centerPos;
+uniform ivec2 wrap;          // slot in grid of the first visible lattice point
+uniform vec2 lattice_shift;  // of the world-snapped lattice from the view
+uniform int mesh_res;        // points per side of the mesh, fewer than grid_res for a preview
+uniform int mesh_stride;     // lattice points between them
+uniform ivec2 mesh_first;    // first one relative to the visible window
+uniform bool mesh_indexed;   // drawn from the adaptive mesh's lattice indices instead
+uniform bool mesh_vertices;  // or from the vertices of meshbuffer
+uniform bool parametric;     // grid holds the points of a parametric surface, see parametric.glsl
 
 uniform bool quad;
 
 out vec3 normal;
 out vec3 fragPos;
 out vec2 gridCoord;
+out vec2 gradient;
+out vec2 pickCoord;          // what the pick of the fragment holds, in [0, 1]
 flat out float inRegion;
 
+// a point of a surface that is no graph over the view's lattice, which the
+// layout of MeshVertex holds
+void surface_point(MeshVertex v) {
+	vec3 c = v.position.xyz;
+	fragPos = vec3(graph_size * (c.x - centerPos.x) / zoomx, graph_size * c.z / zoomz, graph_size * (c.y - centerPos.y) / zoomy);
+	gridCoord = c.xy;
+	inRegion = 1.f;
+	normal = v.normal.xyz;
+	gradient = vec2(v.position.w, v.normal.w);
+	gl_Position = vpmat * vec4(fragPos.x, fragPos.y - centerPos.z / zoomz * graph_size, fragPos.z, 1.f);
+}
+
 void main() {
 	if (quad) {
 		gl_Position = vec4(aPos, 1.f);
 		return;
 	}
-	const float gridres = grid_res + 2;
-	const float halfres = gridres / 2.f;
-	float x = floor(gl_VertexID / grid_res) + 1;
-	float y = (gl_VertexID % grid_res) + 1;
-
-	fragPos = vec3((graph_size / gridres) * (x - halfres), graph_size * grid[2 * int(y * gridres + x)], (graph_size / gridres) * (y - halfres));
-	gridCoord = vec2(zoomx * (x - halfres) / gridres, zoomy * (y - halfres) / gridres) + centerPos.xy;
-	inRegion = grid[2 * int(y * gridres + x) + 1];
-	
-	vec3 v1 = vec3((graph_size / gridres) * (x + 1 - halfres), graph_size * grid[2 * int(y * gridres + (x + 1.f))], (graph_size / gridres) * (y - halfres));
-	vec3 v2 = vec3((graph_size / gridres) * (x - halfres), graph_size * grid[2 * int((y + 1.f) * gridres + x)], (graph_size / gridres) * (y + 1 - halfres));
-
-	vec3 v3 = vec3((graph_size / gridres) * (x - 1 - halfres), graph_size * grid[2 * int(y * gridres + (x - 1.f))], (graph_size / gridres) * (y - halfres));
-	vec3 v4 = vec3((graph_size / gridres) * (x - halfres), graph_size * grid[2 * int((y - 1.f) * gridres + x)], (graph_size / gridres) * (y - 1 - halfres));
-
-	normal = normalize(cross(v1 - fragPos, v2 - fragPos) + cross(v3 - fragPos, v4 - fragPos));
+	if (mesh_vertices) {
+		surface_point(vertices[gl_VertexID]);
+		pickCoord = (gridCoord - centerPos.xy) / vec2(zoomx, zoomy) + 0.5f;
+		return;
+	}
+	int x, y;
+	if (mesh_indexed) {
+		x = gl_VertexID % grid_res;
+		y = gl_VertexID / grid_res;
+	}
+	else {
+		// triangle strip over the mesh, one row of quads per 2 * mesh_res + 2
+		// vertices; the last two of each row are degenerates joining the next row
+		int row = gl_VertexID / (2 * mesh_res + 2);
+		int k = gl_VertexID - row * (2 * mesh_res + 2);
+		if (k == 2 * mesh_res + 1) {
+			row++;
+			k = 0;
+		}
+		k = min(k, 2 * mesh_res - 1);
+		x = mesh_first.x + (row + k % 2) * mesh_stride;
+		y = mesh_first.y + k / 2 * mesh_stride;
+	}
+	ivec2 slot = (wrap + ivec2(x, y)) % grid_res;
+	GridPoint p = grid[slot.y * grid_res + slot.x];
+	if (parametric) {
+		// picked by where on the (u, v) lattice it is
+		surface_point(MeshVertex(p.value, p.normal));
+		pickCoord = vec2(x, y) / float(grid_res - 1);
+		return;
+	}
+	vec2 t = (vec2(x, y) + 0.5f) / float(grid_res) - 0.5f + lattice_shift;
+
+	fragPos = vec3(graph_size * t.x, graph_size * p.value.x, graph_size * t.y);
+	gridCoord = vec2(zoomx, zoomy) * t + centerPos.xy;
+	pickCoord = t + 0.5f;
+	inRegion = p.value.y;
+	normal = p.normal.xyz;
+	gradient = p.value.zw;
 
 	gl_Position = vpmat * vec4(fragPos.x, fragPos.y - centerPos.z / zoomz * graph_size, fragPos.z, 1.f);
 }
\ No newline at end of file
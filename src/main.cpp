@@ -38,6 +38,10 @@
 #include <battery/embed.hpp>
 #include <lodepng.h>
 #include <bmp_read.hpp>
+#include <expression.hpp>
+#include <program_cache.hpp>
+#include <cpu_evaluator.hpp>
+#include <quadtree.hpp>
 #include <nlohmann/json.hpp>
 
 #include <iostream>
@@ -49,7 +53,6 @@
 #include <ctime>
 #include <cmath>
 #include <string>
-#include <regex>
 #include <bitset>
 
 #ifdef PLATFORM_WINDOWS
@@ -75,10 +78,42 @@ public:
     }
 };
 
+// copies a shader log into a 512 byte infoLog, omitting the GLSL details at
+// the start of every line
+void strip_log(const std::string& log, char* infoLog) {
+    int k = 0;
+    for (int i = 0, j = 0; i < log.size() && k < 511; i++, j++) {
+        if (j < 21) continue;
+        infoLog[k++] = log[i];
+        if (log[i] == '\n') j = -1;
+    }
+    infoLog[k] = '\0';
+}
+
 float quad[12] = {
     -1.0f, -1.0f, -1.0f,  1.0f, 1.0f,  1.0f,
     -1.0f, -1.0f,  1.0f,  1.0f, 1.0f, -1.0f
 };
+ProgramCache program_cache;
+
+// local size of the surface evaluation kernel in compute.glsl
+constexpr int tile_size = 16;
+// lattice stride of the preview evaluated while the view or a definition is
+// being changed, halved by each refinement pass once input goes quiet
+constexpr int preview_stride = 4;
+// largest deviation of an adaptive mesh from its graph, in cell widths of the lattice
+constexpr float mesh_tolerance = 0.25f;
+// triangles an implicit surface's mesh grows to at most, the rest of a
+// denser one are dropped
+constexpr GLuint implicit_triangles = 1 << 21;
+// and those it starts with per face cell of its volume, about what a surface
+// spanning the volume a few times over takes
+constexpr GLuint implicit_triangles_per_face_cell = 8;
+// contour segment endpoints a graph keeps at most, with their copies on the floor
+constexpr GLuint contour_points = 1 << 22;
+// levels contour.glsl takes at most
+constexpr int max_contour_levels = 64;
+
 std::vector<vec4> colors = {
     vec4(0.000f, 0.500f, 1.000f, 1.f),
     vec4(0.924f, 0.395f, 0.000f, 1.f),
@@ -128,33 +163,140 @@ struct Slider {
     }
 };
 
+// mirrors the layout of gridbuffer in compute.glsl
+struct GridPoint {
+    vec4 value;  // z / zoomz, in_region, dz/dx, dz/dy
+    vec4 normal;
+};
+
 enum GraphType {
     UserDefined,
     TangentPlane,
 };
 
+enum ExpressionType {
+    Explicit,   // z = f(x, y), evaluated over a lattice by compute.glsl
+    Implicit,   // an equation in x, y and z, polygonized by marchingcubes.glsl
+    Parametric, // (x(u, v), y(u, v), z(u, v)), evaluated over a (u, v) lattice by parametric.glsl
+};
+
+// passes of marchingcubes.glsl
+enum MarchingCubesPass {
+    SampleVolume,
+    ClassifyCells,
+    ScanBlocks,
+    AddBlockOffsets,
+    EmitTriangles,
+};
+
+// dispatches groups workgroups, over two dimensions past the limit of one
+void dispatch_groups(GLuint groups) {
+    GLuint x = std::min(groups, 32768u);
+    glDispatchCompute(x, (groups + x - 1) / x, 1);
+}
+
+// offsets of the levels of the prefix sum over count elements in scanbuffer
+// of marchingcubes.glsl, each followed by the next of a block total per 1024
+// of its elements, up to a single block; the last offset is the grand total's
+std::vector<GLuint> scan_levels(GLuint count) {
+    std::vector<GLuint> offsets{ 0 };
+    for (GLuint size = count;; size = (size + 1023) / 1024) {
+        offsets.push_back(offsets.back() + size);
+        if (size <= 1024) return offsets;
+    }
+}
+
+// the symbols of every expression entered by the user besides its
+// variables: the constants and the valid sliders, read from sliderbuffer
+SymbolTable expression_symbols(const std::vector<Slider>& sliders) {
+    SymbolTable symbols;
+    symbols.add_constant("PI", M_PI);
+    symbols.add_constant("e", M_E);
+    for (int i = 0; i < sliders.size(); i++)
+        if (sliders[i].valid) symbols.add_slider(sliders[i].symbol, i);
+    return symbols;
+}
+
 class Graph {
 public:
-    GLuint computeProgram = 0, SSBO, EBO;
+    GLuint computeProgram = 0, SSBO = 0;
+    GLuint EBO = 0;         // triangles of the adaptive mesh
+    GLuint errorBuffer = 0; // its quadtree's node errors, read back once errorFence signals
+    GLsync errorFence = nullptr;
+    uint64_t error_stamp = 0; // and the grid they were computed from
+    ivec2 error_origin{};
+    GLuint fieldBuffer = 0; // arrows of the gradient field, see Trisualizer::update_vector_field
+    GLuint scanBuffer = 0, meshBuffer = 0, drawBuffer = 0; // of an implicit surface, see polygonize
+    GLuint mesh_capacity = 0; // triangles meshBuffer holds
+    GLuint countBuffer = 0;   // triangles the last polygonization counted, read back once countFence signals
+    GLsync countFence = nullptr;
+    GLuint contourBuffer = 0, contourDraw = 0; // segments of the contours, see Trisualizer::draw_contours
+    GLuint contour_capacity = 0; // endpoints contourBuffer holds
+    // what contourBuffer was last marched for
+    struct ContourKey {
+        uint64_t stamp = 0;
+        ivec2 origin{}, wrap{};
+        int stride = 0;
+        bool floor = false;
+        std::vector<float> levels;
+        bool operator==(const ContourKey&) const = default;
+    } contour_key;
     size_t idx;
     bool enabled = false;
     bool valid = false;
     bool advanced_view = false;
     bool grid_lines = false;
+    bool adaptive = false;
+    bool mesh_dirty = true; // evaluated since the adaptive mesh was built
+    GLsizei mesh_indices = 0;
+    bool vector_field = false;
+    int field_res = 30;     // arrows per side
+    GLsizeiptr field_capacity = 0;
+    // what fieldBuffer was last filled for, see Trisualizer::update_vector_field
+    struct FieldKey {
+        uint64_t stamp = 0;
+        ivec2 origin{};
+        int stride = 0;
+        int field_res = 0;
+        vec2 lattice_shift{};
+        float center_height = 0.f;
+        vec4 color{}, secondary_color{};
+        bool operator==(const FieldKey&) const = default;
+    } field_key;
+    bool contours = false;
+    int contour_count = 10; // evenly spaced over the view when contour_list is empty
+    bool contour_floor = false;
+    char contour_list[128]{}; // z of every contour, separated by commas
     float shininess = 16;
     char* infoLog = new char[512]{};
     int type;
+    int form = Explicit;    // ExpressionType of computeProgram
+    int pending_form = Explicit; // and of the last generated source, taken on by use_program
     int grid_res;
-    std::vector<unsigned int> indices;
+    int volume_res = 128;   // cells per side of an implicit surface's volume
+    vec2 u_range = vec2(0.f, 2.f * M_PI), v_range = vec2(0.f, M_PI); // of a parametric surface's lattice
+    int eval_res = 0;       // grid_res as scaled by the resolution controller, what SSBO holds
+    int buffer_res = 0;
+    unsigned int version = 0;
+    uint64_t stamp = 0;
+    ivec2 origin{}, wrap{}; // lattice index and SSBO slot of the first visible point
+    int stride = 1;         // only lattice points at multiples of it are evaluated yet
+    uint64_t ticket = 0;    // program_cache request of a definition still compiling
+    bool compiling = false;
+    CpuEvaluator cpu;       // the same definition for evaluation without the compute pass
+    bool cpu_ready = false;
+    float plane_params[5]{};
 
     char defn[256]{};
     vec4 color;
     vec4 secondary_color;
 
     Graph() = default;
-    Graph(size_t idx, int type, const char* definition, int res, vec4 color, vec4 color2, bool enabled, GLuint SSBO, GLuint EBO)
-        : type(type), idx(idx), grid_res(res), color(color), secondary_color(color2), enabled(enabled), SSBO(SSBO), EBO(EBO) {
+    Graph(size_t idx, int type, const char* definition, int res, vec4 color, vec4 color2, bool enabled)
+        : type(type), idx(idx), grid_res(res), color(color), secondary_color(color2), enabled(enabled) {
         strcpy(defn, definition);
+        glGenBuffers(1, &SSBO);
+        glGenBuffers(1, &fieldBuffer);
     }
 
     Graph& operator=(const Graph& other) {
@@ -162,109 +304,601 @@ public:
             idx = other.idx;
             enabled = other.enabled;
             grid_lines = other.grid_lines;
+            adaptive = other.adaptive;
+            vector_field = other.vector_field;
+            field_res = other.field_res;
+            contours = other.contours;
+            contour_count = other.contour_count;
+            contour_floor = other.contour_floor;
+            memcpy(contour_list, other.contour_list, sizeof(contour_list));
             shininess = other.shininess;
             type = other.type;
+            form = other.form;
+            pending_form = other.pending_form;
             grid_res = other.grid_res;
+            volume_res = other.volume_res;
+            u_range = other.u_range;
+            v_range = other.v_range;
+            eval_res = other.eval_res;
             memcpy(defn, other.defn, 256);
             color = other.color;
             secondary_color = other.secondary_color;
+            // GL objects move along with the graph when it is shifted down by erase()
+            computeProgram = other.computeProgram;
+            SSBO = other.SSBO;
+            EBO = other.EBO;
+            errorBuffer = other.errorBuffer;
+            errorFence = other.errorFence;
+            error_stamp = other.error_stamp;
+            error_origin = other.error_origin;
+            fieldBuffer = other.fieldBuffer;
+            field_capacity = other.field_capacity;
+            field_key = other.field_key;
+            scanBuffer = other.scanBuffer;
+            meshBuffer = other.meshBuffer;
+            drawBuffer = other.drawBuffer;
+            mesh_capacity = other.mesh_capacity;
+            countBuffer = other.countBuffer;
+            countFence = other.countFence;
+            contourBuffer = other.contourBuffer;
+            contourDraw = other.contourDraw;
+            contour_capacity = other.contour_capacity;
+            contour_key = other.contour_key;
+            mesh_dirty = other.mesh_dirty;
+            mesh_indices = other.mesh_indices;
+            valid = other.valid;
+            buffer_res = other.buffer_res;
+            version = other.version;
+            stamp = other.stamp;
+            origin = other.origin;
+            wrap = other.wrap;
+            stride = other.stride;
+            ticket = other.ticket;
+            compiling = other.compiling;
+            cpu = other.cpu;
+            cpu_ready = other.cpu_ready;
+            memcpy(plane_params, other.plane_params, sizeof(plane_params));
+            memcpy(infoLog, other.infoLog, 512);
         }
         return *this;
     }
 
-    void setup() {
-        indices.clear();
-        for (unsigned int y = 0; y < grid_res - 1; ++y) {
-            for (unsigned int x = 0; x < grid_res; ++x) {
-                unsigned int idx0 = y * grid_res + x;
-                unsigned int idx1 = (y + 1) * grid_res + x;
+    void release() {
+        cancel_request();
+        if (computeProgram != 0) program_cache.release(computeProgram);
+        glDeleteBuffers(1, &SSBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &errorBuffer);
+        if (errorFence) glDeleteSync(errorFence);
+        errorFence = nullptr;
+        glDeleteBuffers(1, &fieldBuffer);
+        glDeleteBuffers(1, &scanBuffer);
+        glDeleteBuffers(1, &meshBuffer);
+        glDeleteBuffers(1, &drawBuffer);
+        glDeleteBuffers(1, &countBuffer);
+        if (countFence) glDeleteSync(countFence);
+        countFence = nullptr;
+        glDeleteBuffers(1, &contourBuffer);
+        glDeleteBuffers(1, &contourDraw);
+        computeProgram = SSBO = EBO = errorBuffer = fieldBuffer = scanBuffer = meshBuffer = drawBuffer = countBuffer = contourBuffer = contourDraw = 0;
+        mesh_capacity = contour_capacity = 0;
+        contour_key = {};
+    }
 
-                indices.push_back(idx0);
-                indices.push_back(idx1);
-            }
-            if (y < grid_res - 2) {
-                indices.push_back((y + 1) * grid_res + (grid_res - 1));
-                indices.push_back((y + 1) * grid_res);
+    // lattice points per side of the mesh drawn over the evaluated ones
+    int mesh_res() const {
+        return (eval_res - stride) / stride + 1;
+    }
+
+    // first lattice index at or after i that is evaluated at the current stride
+    int align(int i) const {
+        int r = (i % stride + stride) % stride;
+        return r == 0 ? i : i + stride - r;
+    }
+
+    // z of the contours, those of contour_list or else contour_count evenly
+    // spaced over the view's z range; the line shader drops those outside it
+    std::vector<float> contour_levels(float zoomz, vec3 centerPos) const {
+        std::vector<float> levels;
+        const char* p = contour_list;
+        while (*p && levels.size() < max_contour_levels) {
+            char* end;
+            float z = strtof(p, &end);
+            if (end == p) p++;
+            else {
+                levels.push_back(z);
+                p = end;
             }
         }
+        if (levels.empty()) {
+            for (int k = 0; k < contour_count; k++)
+                levels.push_back(centerPos.z + zoomz * ((k + 0.5f) / contour_count - 0.5f));
+        }
+        return levels;
     }
 
-    void upload_definition(std::vector<Slider>& sliders, const char* regionBool = "true", const char* scalarField = "z", bool polar = false, bool partialderivatives = false) {
-        int success;
+    // vertex count of the degenerate-joined triangle strip that vertex.glsl
+    // derives from gl_VertexID: 2 * mesh_res + 2 per row of quads, minus the
+    // trailing degenerate pair
+    GLsizei strip_vertices() const {
+        return (mesh_res() - 1) * (2 * mesh_res() + 2) - 2;
+    }
 
-        auto replace = [&](std::string& source, std::string x, std::string y) {
-            std::string pattern = "\\b";
-            pattern.append(x);
-            pattern.append("\\b");
-            return std::regex_replace(source, std::regex(pattern), y);
-        };
+    // position of the '=' of an equation lhs = rhs in defn, which is no
+    // operator of the expression language, or npos for an explicit graph
+    size_t equation_sign() const {
+        for (size_t i = 0; defn[i]; i++)
+            if (defn[i] == '=' && (i == 0 || !strchr("<>=!", defn[i - 1])) && defn[i + 1] != '=') return i;
+        return std::string::npos;
+    }
+
+    // the components of a parametric definition (x(u, v), y(u, v), z(u, v)),
+    // false for any other
+    bool parametric_components(std::vector<std::string>& parts) const {
+        std::string text = defn;
+        size_t first = text.find_first_not_of(" \t"), last = text.find_last_not_of(" \t");
+        if (first == std::string::npos || text[first] != '(' || text[last] != ')') return false;
+        parts.assign(1, "");
+        int depth = 0;
+        for (size_t i = first + 1; i < last; i++) {
+            if (text[i] == '(' || text[i] == '[') depth++;
+            if (text[i] == ')' || text[i] == ']') depth--;
+            // the first parenthesis closes before the last, as in (x + 1) * (y + 1)
+            if (depth < 0) return false;
+            if (depth == 0 && text[i] == ',') parts.emplace_back();
+            else parts.back() += text[i];
+        }
+        return parts.size() == 3;
+    }
 
-        std::string pdefn = defn;
-        pdefn.resize(512);
-        for (int i = 0; i < sliders.size(); i++) {
-            if (!sliders[i].valid) continue;
-            std::string temp = replace(pdefn, sliders[i].symbol, std::format("sliders[{}]", i));
-            sliders[i].used_in[idx] = (pdefn != temp);
-            pdefn = temp;
+    // compute.glsl specialised for the current definition, marchingcubes.glsl
+    // for an equation or parametric.glsl for a triple of components; false
+    // with the parse error in infoLog if it has none
+    bool generate_source(std::vector<Slider>& sliders, const char* regionBool, const char* scalarField, std::string& source) {
+        std::vector<std::string> components;
+        size_t eq = equation_sign();
+        pending_form = parametric_components(components) ? Parametric : eq == std::string::npos ? Explicit : Implicit;
+
+        SymbolTable symbols = expression_symbols(sliders);
+        if (pending_form == Parametric) {
+            symbols.add_variable("u");
+            symbols.add_variable("v");
+        }
+        else {
+            symbols.add_variable("x");
+            symbols.add_variable("y");
+            symbols.add_macro("t", "atan(-y, -x) + PI");
+        }
+        symbols.add_array("plane_params", 5);
+
+        // syntax and symbol errors are reported here, without a round trip through the driver
+        Expression expr;
+        std::string error;
+        std::string bodies[3];
+        std::vector<int> used;
+        bool parsed = true;
+        if (pending_form == Parametric) {
+            const char* names[]{ "x", "y", "z" };
+            for (int i = 0; i < 3 && parsed; i++) {
+                parsed = expr.parse(components[i], symbols, error);
+                if (!parsed) error = std::format("{} component: {}", names[i], error);
+                else bodies[i] = expr.dual_glsl("u", "v");
+                used.insert(used.end(), expr.used_sliders.begin(), expr.used_sliders.end());
+            }
+        }
+        else if (pending_form == Implicit) {
+            // F = lhs - rhs, each side parsed alone first so that error columns point into it
+            symbols.add_variable("z");
+            std::string lhs(defn, eq), rhs(defn + eq + 1);
+            Expression side;
+            parsed = false;
+            if (!side.parse(lhs, symbols, error)) error = "left side: " + error;
+            else if (!side.parse(rhs, symbols, error)) error = "right side: " + error;
+            else parsed = expr.parse("(" + lhs + ") - (" + rhs + ")", symbols, error);
+        }
+        else parsed = expr.parse(defn, symbols, error);
+
+        // the scalar field and region an integral sums over, in terms of the graph
+        SymbolTable fields = symbols;
+        fields.add_variable("z");
+        fields.add_variable("px");
+        fields.add_variable("py");
+        Expression scalar, region;
+        if (parsed && pending_form == Explicit) {
+            parsed = false;
+            if (!scalar.parse(scalarField, fields, error)) error = "scalar field: " + error;
+            else if (!region.parse(regionBool, fields, error, true)) error = "region: " + error;
+            else parsed = true;
+            used.insert(used.end(), scalar.used_sliders.begin(), scalar.used_sliders.end());
+            used.insert(used.end(), region.used_sliders.begin(), region.used_sliders.end());
+        }
+        if (!parsed) {
+            for (Slider& s : sliders) s.used_in[idx] = false;
+            snprintf(infoLog, 512, "%s", error.c_str());
+            valid = enabled = false;
+            return false;
         }
+        for (int i = 0; i < sliders.size(); i++)
+            sliders[i].used_in[idx] = expr.uses_slider(i) || std::find(used.begin(), used.end(), i) != used.end();
 
         b::EmbedInternal::EmbeddedFile embed;
+        embed = b::embed<"shaders/dual.glsl">();
+        std::string helpers(embed.data(), embed.length());
+        if (pending_form == Parametric) {
+            cpu_ready = false;
+            embed = b::embed<"shaders/parametric.glsl">();
+            size_t size = embed.length() + helpers.size() + bodies[0].size() + bodies[1].size() + bodies[2].size() + 1;
+            source.resize(size);
+            source.resize(snprintf(source.data(), size, embed.data(), helpers.c_str(), bodies[0].c_str(), bodies[1].c_str(), bodies[2].c_str()));
+            return true;
+        }
+        if (pending_form == Implicit) {
+            std::string body = expr.glsl();
+            cpu_ready = false;
+            embed = b::embed<"shaders/marchingcubes.glsl">();
+            size_t size = embed.length() + helpers.size() + body.size() + 1;
+            source.resize(size);
+            source.resize(snprintf(source.data(), size, embed.data(), helpers.c_str(), body.c_str()));
+            return true;
+        }
+        std::string body = expr.dual_glsl(), scalar_body = scalar.glsl(), region_body = region.glsl();
+        cpu_ready = cpu.compile(expr, scalar, region, error);
+
         const char* content;
         int length;
 
-        unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
         embed = b::embed<"shaders/compute.glsl">();
         content = embed.data();
         length = embed.length();
-        size_t size = length + pdefn.capacity() + 7;
-        char* modifiedSource = new char[size];
-        snprintf(modifiedSource, size, content, pdefn.c_str(), partialderivatives ? "true" : "false", polar ? "" : "//", scalarField, regionBool);
-        glShaderSource(computeShader, 1, &modifiedSource, NULL);
-        glCompileShader(computeShader);
-        glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char temp[512];
-            glGetShaderInfoLog(computeShader, 512, NULL, temp);
-            int k = 0;
-            for (int i = 0, j = 0; i < strlen(temp); i++, j++) {
-                if (j < 21) continue; // omit GLSL details
-                infoLog[k++] = temp[i];
-                if (temp[i] == '\n') j = -1;
-            }
-            infoLog[k] = '\0';
+        size_t size = length + helpers.size() + body.size() + scalar_body.size() + region_body.size() + 1;
+        source.resize(size);
+        source.resize(snprintf(source.data(), size, content, helpers.c_str(), body.c_str(), scalar_body.c_str(), region_body.c_str()));
+        return true;
+    }
+
+    // switches to a freshly acquired program, or reports why there is none
+    void use_program(GLuint program, const std::string& log) {
+        if (program == 0) {
+            strip_log(log, infoLog);
             valid = enabled = false;
             return;
         }
-        if (computeProgram != 0) glDeleteProgram(computeProgram);
-        computeProgram = glCreateProgram();
-        glAttachShader(computeProgram, computeShader);
-        glLinkProgram(computeProgram);
-        glDeleteShader(computeShader);
+        if (computeProgram != 0) program_cache.release(computeProgram);
+        computeProgram = program;
+        // SSBO holds a lattice of a different size for the other form
+        if (form != pending_form) buffer_res = 0;
+        form = pending_form;
         glUseProgram(computeProgram);
-        delete[] modifiedSource;
 
         glShaderStorageBlockBinding(computeProgram, glGetProgramResourceIndex(computeProgram, GL_SHADER_STORAGE_BLOCK, "gridbuffer"), 0);
         glShaderStorageBlockBinding(computeProgram, glGetProgramResourceIndex(computeProgram, GL_SHADER_STORAGE_BLOCK, "sliderbuffer"), 3);
+        if (form == Explicit)
+            glShaderStorageBlockBinding(computeProgram, glGetProgramResourceIndex(computeProgram, GL_SHADER_STORAGE_BLOCK, "partialbuffer"), 5);
         if (!valid) enabled = true;
         valid = true;
+        version++;
     }
 
-    void use_compute(float zoomx, float zoomy, float zoomz, vec3 centerPos) const {
+    void upload_definition(std::vector<Slider>& sliders, const char* regionBool = "true", const char* scalarField = "z") {
+        cancel_request();
+        std::string source, log;
+        if (!generate_source(sliders, regionBool, scalarField, source)) return;
+        use_program(program_cache.acquire({ { GL_COMPUTE_SHADER, source.c_str() } }, log), log);
+    }
+
+    // like upload_definition, but without waiting for the driver: the
+    // current program keeps being used until poll_definition finds the new one
+    // linked. A newer request drops the one still compiling
+    void request_definition(std::vector<Slider>& sliders) {
+        cancel_request();
+        std::string source, log;
+        if (!generate_source(sliders, "true", "z", source)) return;
+        GLuint program = 0;
+        if (program_cache.request({ { GL_COMPUTE_SHADER, source.c_str() } }, ticket, program, log) == ProgramCache::Pending)
+            compiling = true;
+        else
+            use_program(program, log);
+    }
+
+    void poll_definition() {
+        if (!compiling) return;
+        GLuint program = 0;
+        std::string log;
+        if (program_cache.poll(ticket, program, log) == ProgramCache::Pending) return;
+        compiling = false;
+        use_program(program, log);
+    }
+
+    void cancel_request() {
+        if (compiling) program_cache.cancel(ticket);
+        compiling = false;
+    }
+
+    // FNV-1a over everything the evaluated grid depends on, except where it
+    // is centered: the lattice is fixed in world space, panning only shifts
+    // the visible window over it. The volume of an implicit surface is not,
+    // so center is hashed for it
+    uint64_t evaluation_stamp(const std::vector<Slider>& sliders, float zoomx, float zoomy, float zoomz, bool on_cpu, const vec3* center = nullptr) const {
+        uint64_t h = 14695981039346656037ull;
+        auto hash = [&](const void* data, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                h ^= static_cast<const unsigned char*>(data)[i];
+                h *= 1099511628211ull;
+            }
+        };
+        hash(&computeProgram, sizeof(computeProgram));
+        hash(&version, sizeof(version));
+        hash(&eval_res, sizeof(eval_res));
+        hash(&zoomx, sizeof(zoomx));
+        hash(&zoomy, sizeof(zoomy));
+        hash(&zoomz, sizeof(zoomz));
+        hash(&on_cpu, sizeof(on_cpu));
+        hash(plane_params, sizeof(plane_params));
+        hash(&u_range, sizeof(u_range));
+        hash(&v_range, sizeof(v_range));
+        if (center) hash(center, sizeof(vec3));
+        for (const Slider& s : sliders)
+            if (idx < s.used_in.size() && s.used_in[idx])
+                hash(&s.value, sizeof(s.value));
+        return h;
+    }
+
+    // lattice point i sits at (i + 0.5) * zoom / eval_res, the visible
+    // window is the eval_res points centered closest to centerPos
+    ivec2 lattice_origin(float zoomx, float zoomy, vec3 centerPos) const {
+        return {
+            (int)std::round((double)centerPos.x / zoomx * eval_res - eval_res / 2.0),
+            (int)std::round((double)centerPos.y / zoomy * eval_res - eval_res / 2.0),
+        };
+    }
+
+    // offset of the snapped lattice from the unsnapped one, in units of the
+    // graph's extent; vertex.glsl adds it to every point, at most half a cell
+    vec2 lattice_shift(float zoomx, float zoomy, vec3 centerPos) const {
+        return {
+            (float)((double)origin.x / eval_res + 0.5 - (double)centerPos.x / zoomx),
+            (float)((double)origin.y / eval_res + 0.5 - (double)centerPos.y / zoomy),
+        };
+    }
+
+    // re-runs the compute pass only when the stamp changed, otherwise the
+    // grid left in SSBO by the last evaluation is reused. SSBO wraps around in
+    // both directions, so when the view is only panned by less than its
+    // extent, only the strips of lattice points that scrolled into view are
+    // evaluated, into the slots of the ones that scrolled out. With coarse a
+    // changed grid is evaluated at preview_stride first, and refined a pass
+    // per call once coarse is false again; refinement keeps the points
+    // already evaluated. With on_cpu the grid is evaluated by cpu and uploaded.
+    // The lattice has grid_res scaled by res_scale points per side. That of
+    // a parametric surface is over u_range and v_range instead, and with its
+    // origin always at 0 it is never panned
+    void evaluate(const std::vector<Slider>& sliders, float zoomx, float zoomy, float zoomz, vec3 centerPos, bool on_cpu = false, bool coarse = false, float res_scale = 1.f) {
+        on_cpu &= cpu_ready;
+        eval_res = std::max(10, (int)std::round(grid_res * res_scale));
+        uint64_t s = evaluation_stamp(sliders, zoomx, zoomy, zoomz, on_cpu);
+        ivec2 o = form == Parametric ? ivec2(0) : lattice_origin(zoomx, zoomy, centerPos);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+        if (s == stamp && o == origin) {
+            if (coarse || stride == 1) return;
+            stride /= 2;
+            mesh_dirty = true;
+            use_compute(zoomx, zoomy, zoomz, centerPos);
+            evaluate_region(origin, ivec2(eval_res), zoomx, zoomy, true);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            return;
+        }
+        mesh_dirty = true;
+        ivec2 d = o - origin;
+        bool pan = s == stamp && !on_cpu && abs(d.x) < eval_res && abs(d.y) < eval_res;
+        stamp = s;
+        origin = o;
+        if (on_cpu) {
+            std::vector<float> values(sliders.size());
+            for (int i = 0; i < values.size(); i++) values[i] = sliders[i].value;
+            std::vector<GridPoint> points((size_t)eval_res * eval_res);
+            // centered on the snapped window, which then starts at slot 0
+            float cx = (float)(((double)o.x + eval_res / 2.0) * zoomx / eval_res);
+            float cy = (float)(((double)o.y + eval_res / 2.0) * zoomy / eval_res);
+            cpu.evaluate(&points[0].value.x, { eval_res, zoomx, zoomy, zoomz, cx, cy }, values, plane_params);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, points.size() * sizeof(GridPoint), points.data(), GL_DYNAMIC_DRAW);
+            buffer_res = eval_res;
+            wrap = ivec2(0);
+            stride = 1;
+            return;
+        }
+        use_compute(zoomx, zoomy, zoomz, centerPos);
+        if (!pan) {
+            wrap = ivec2(0);
+            // no coarser than a 64 point mesh
+            for (stride = coarse ? preview_stride : 1; stride > 1 && eval_res / stride < 64; stride /= 2);
+            evaluate_region(o, ivec2(eval_res), zoomx, zoomy);
+        }
+        else {
+            wrap = (wrap + d % eval_res + eval_res) % eval_res;
+            // columns then rows that entered the window, the corner they share is evaluated twice
+            if (d.x > 0) evaluate_region({ o.x + eval_res - d.x, o.y }, { d.x, eval_res }, zoomx, zoomy);
+            if (d.x < 0) evaluate_region(o, { -d.x, eval_res }, zoomx, zoomy);
+            if (d.y > 0) evaluate_region({ o.x, o.y + eval_res - d.y }, { eval_res, d.y }, zoomx, zoomy);
+            if (d.y < 0) evaluate_region(o, { eval_res, -d.y }, zoomx, zoomy);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // dispatches the compute pass over the lattice points of the current
+    // stride among size from start, which must lie in the visible window.
+    // With refine the ones already evaluated at twice the stride are skipped
+    void evaluate_region(ivec2 start, ivec2 size, float zoomx, float zoomy, bool refine = false) {
+        ivec2 first = { align(start.x), align(start.y) };
+        ivec2 count = (start + size - first + stride - 1) / stride;
+        if (count.x <= 0 || count.y <= 0) return;
+        ivec2 slot = (wrap + first - origin) % eval_res;
+        ivec2 phase = ((first / stride) % 2 + 2) % 2;
+        vec2 world = {
+            (float)(((double)first.x + 0.5) * zoomx / eval_res),
+            (float)(((double)first.y + 0.5) * zoomy / eval_res),
+        };
+        glUniform1i(glGetUniformLocation(computeProgram, "stride"), stride);
+        glUniform1i(glGetUniformLocation(computeProgram, "refine"), refine);
+        glUniform2i(glGetUniformLocation(computeProgram, "region_size"), count.x, count.y);
+        glUniform2i(glGetUniformLocation(computeProgram, "region_slot"), slot.x, slot.y);
+        glUniform2i(glGetUniformLocation(computeProgram, "region_phase"), phase.x, phase.y);
+        glUniform2fv(glGetUniformLocation(computeProgram, "region_world"), 1, value_ptr(world));
+        glDispatchCompute((count.x + tile_size - 1) / tile_size, (count.y + tile_size - 1) / tile_size, 1);
+    }
+
+    // polygonizes the implicit surface over the box of the view with
+    // marching cubes, on a lattice of volume_res scaled by res_scale cells per
+    // side: F is sampled at the lattice points, the triangles of every cell
+    // are counted and prefix summed, and every cell writes its triangles from
+    // its sum on into meshBuffer. drawBuffer is left with their count for
+    // glDrawArraysIndirect, so nothing is read back in the frame. meshBuffer
+    // starts sized from the volume's faces; the count is also copied into
+    // countBuffer, and once it arrives a mesh that did not fit is grown to
+    // it and polygonized again. table holds triang
+    void polygonize(const std::vector<Slider>& sliders, float zoomx, float zoomy, float zoomz, vec3 centerPos, GLuint table, float res_scale = 1.f) {
+        eval_res = std::max(16, (int)std::round(volume_res * res_scale));
+        if (countFence) {
+            GLenum status = glClientWaitSync(countFence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(countFence);
+                countFence = nullptr;
+                GLuint count = 0;
+                glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+                glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(count), &count);
+                if (count > mesh_capacity && mesh_capacity < implicit_triangles) {
+                    mesh_capacity = std::min(implicit_triangles, count + count / 4);
+                    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+                    glBufferData(GL_SHADER_STORAGE_BUFFER, mesh_capacity * 3ull * 2 * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+                    stamp = 0;
+                }
+            }
+        }
+        uint64_t s = evaluation_stamp(sliders, zoomx, zoomy, zoomz, false, &centerPos);
+        if (s == stamp) return;
+        stamp = s;
+
+        GLuint n = eval_res, cells = n * n * n, points = (n + 1) * (n + 1) * (n + 1);
+        std::vector<GLuint> levels = scan_levels(cells);
+        if (buffer_res != eval_res) {
+            if (scanBuffer == 0) {
+                glGenBuffers(1, &scanBuffer);
+                glGenBuffers(1, &meshBuffer);
+                glGenBuffers(1, &drawBuffer);
+                glGenBuffers(1, &countBuffer);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, countBuffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+            }
+            GLuint estimate = std::min(implicit_triangles, implicit_triangles_per_face_cell * n * n);
+            if (mesh_capacity < estimate) {
+                mesh_capacity = estimate;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, mesh_capacity * 3ull * 2 * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)points * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, scanBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, ((size_t)levels.back() + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+            buffer_res = eval_res;
+        }
+
         glUseProgram(computeProgram);
         glUniform1f(glGetUniformLocation(computeProgram, "zoomx"), zoomx);
         glUniform1f(glGetUniformLocation(computeProgram, "zoomy"), zoomy);
         glUniform1f(glGetUniformLocation(computeProgram, "zoomz"), zoomz);
-        glUniform1i(glGetUniformLocation(computeProgram, "grid_res"), grid_res + 2);
         glUniform3fv(glGetUniformLocation(computeProgram, "centerPos"), 1, value_ptr(centerPos));
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * pow(grid_res + 2, 2) * (int)sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        glUniform1i(glGetUniformLocation(computeProgram, "volume_res"), eval_res);
+        glUniform1ui(glGetUniformLocation(computeProgram, "max_triangles"), mesh_capacity);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, table);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, scanBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, meshBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, drawBuffer);
+        GLint pass = glGetUniformLocation(computeProgram, "pass");
+
+        glUniform1i(pass, SampleVolume);
+        dispatch_groups((points + 255) / 256);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glUniform1i(pass, ClassifyCells);
+        dispatch_groups((cells + 255) / 256);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // up the levels, each scanned in blocks whose totals make the next
+        glUniform1i(pass, ScanBlocks);
+        for (size_t l = 0; l + 1 < levels.size(); l++) {
+            GLuint level_size = levels[l + 1] - levels[l];
+            glUniform1ui(glGetUniformLocation(computeProgram, "level_offset"), levels[l]);
+            glUniform1ui(glGetUniformLocation(computeProgram, "level_size"), level_size);
+            glUniform1ui(glGetUniformLocation(computeProgram, "next_offset"), levels[l + 1]);
+            glUniform1i(glGetUniformLocation(computeProgram, "last_level"), l + 2 == levels.size());
+            dispatch_groups((level_size + 1023) / 1024);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        // and back down, adding the scanned totals to their blocks
+        glUniform1i(pass, AddBlockOffsets);
+        for (size_t l = levels.size() - 2; l-- > 0;) {
+            GLuint level_size = levels[l + 1] - levels[l];
+            glUniform1ui(glGetUniformLocation(computeProgram, "level_offset"), levels[l]);
+            glUniform1ui(glGetUniformLocation(computeProgram, "level_size"), level_size);
+            glUniform1ui(glGetUniformLocation(computeProgram, "next_offset"), levels[l + 1]);
+            dispatch_groups((level_size + 255) / 256);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        glUniform1i(pass, EmitTriangles);
+        dispatch_groups((cells + 255) / 256);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // the grand total, which the last level's block left after the levels
+        if (countFence) glDeleteSync(countFence);
+        glBindBuffer(GL_COPY_READ_BUFFER, scanBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, countBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t)levels.back() * sizeof(GLuint), 0, sizeof(GLuint));
+        countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     }
-    void use_shader() const {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+
+    void use_compute(float zoomx, float zoomy, float zoomz, vec3 centerPos) {
+        glUseProgram(computeProgram);
+        glUniform1f(glGetUniformLocation(computeProgram, "zoomx"), zoomx);
+        glUniform1f(glGetUniformLocation(computeProgram, "zoomy"), zoomy);
+        glUniform1f(glGetUniformLocation(computeProgram, "zoomz"), zoomz);
+        glUniform1i(glGetUniformLocation(computeProgram, "grid_res"), eval_res);
+        glUniform3fv(glGetUniformLocation(computeProgram, "centerPos"), 1, value_ptr(centerPos));
+        glUniform2fv(glGetUniformLocation(computeProgram, "u_range"), 1, value_ptr(u_range));
+        glUniform2fv(glGetUniformLocation(computeProgram, "v_range"), 1, value_ptr(v_range));
+        // programs are shared through program_cache, so reset what an integral job may have set
+        glUniform1i(glGetUniformLocation(computeProgram, "reduce"), false);
+        glUniform1i(glGetUniformLocation(computeProgram, "group_offset"), 0);
+        glUniform1fv(glGetUniformLocation(computeProgram, "plane_params"), 5, plane_params);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+        if (buffer_res != eval_res) {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)eval_res * eval_res * sizeof(GridPoint), nullptr, GL_DYNAMIC_DRAW);
+            buffer_res = eval_res;
+        }
     }
 };
 
+// per instance attributes of the arrow mesh of Trisualizer::draw_vectors
+struct VectorInstance {
+    mat4 model;
+    vec4 shape; // length, tip height, shaft radius, head radius
+    vec4 color;
+};
+
+// a double or surface integral summed a band of workgroup rows per frame
+struct IntegralJob {
+    Graph g;
+    vec2 size;   // extent of the region's bounding box
+    vec3 center;
+    int group_rows = 0, rows_per_band = 1;
+    int next_row = 0, summed_rows = 0;
+    int result_buffer = 0;
+    double sum = 0.0, compensation = 0.0;
+    GLsync fence = nullptr;
+    bool active = false;
+};
+
 enum RegionType {
     CartesianRectangle,
     Type1,
@@ -272,6 +906,23 @@ enum RegionType {
     Polar,
 };
 
+enum AntiAliasing {
+    NoAA,
+    SSAA,   // rendered at render_scale, downsampled in two separable passes
+    MSAA,
+    FXAA,
+    TAA,    // jittered every frame and accumulated into a reprojected history
+};
+
+// filter of the quad pass in fragment.glsl
+enum ResolvePass {
+    ResolveCopy,
+    ResolveHorizontal,
+    ResolveVertical,
+    ResolveFXAA,
+    ResolveTAA,
+};
+
 enum ColoringStyle {
     SingleColor,
     TopBottom,
@@ -280,11 +931,6 @@ enum ColoringStyle {
     NormalMap,
 };
 
-enum ExpressionType {
-    Explicit,
-    Implicit,
-};
-
 enum IntegralType {
     None,
     DoubleIntegral,
@@ -299,6 +945,7 @@ const int triang[256 * 15]{
 
 class Trisualizer {
     GLFWwindow* window = nullptr;
+    GLFWwindow* compileWindow = nullptr; // hidden, owns the context definitions are compiled on
     ImFont* font_title = nullptr;
 public:
     std::vector<Graph> graphs;
@@ -308,6 +955,7 @@ public:
     vec2 cameraVelocity = vec2(0.f);
     std::bitset<4> keys{ 0x0 };
     double zoomTimestamp = 0.f;
+    double interactionTimestamp = 0.f; // last frame the view or an input widget was changing
     float zoomSpeed = 1.f;
     float zoomx = 8.f;
     float zoomy = 8.f;
@@ -315,6 +963,7 @@ public:
     float graph_size = 1.3f;
     float gridLineDensity = 3.f;
     bool shading = true;
+    bool cpu_evaluation = false; // grids and integrals evaluated by the CPU backend instead of compute shaders
     int coloring = SingleColor;
     bool autoRotate = false;
     bool tangent_plane = false, apply_tangent_plane = false;
@@ -331,11 +980,13 @@ public:
     char x_min_eq[32]{}, x_max_eq[32]{}, y_min_eq[32]{}, y_max_eq[32]{}, r_min_eq[32]{}, r_max_eq[32]{}, x_param_eq[32]{}, y_param_eq[32]{}, scalar_field_eq[32]{}, integral_infoLog[512]{};
     float x_min_eq_min{}, x_max_eq_max{}, y_min_eq_min{}, y_max_eq_max{};
     vec3 center_of_region;
-    float integral_result, dx, dy, dt;
+    double integral_result;
+    IntegralJob integral_job;
+    int integral_band_points = 1 << 20;
+    float dx, dy, dt;
     IntegralType last_integration_type;
-    float* li_data = nullptr;
-    float* li_data_ws = nullptr;
-    size_t li_samplecount = 0;
+    GLuint lineSamples = 0; // f, speed, x, y per sample of the last line integral
+    GLsizei li_samplecount = 0;
 
     vec3 vector_start = vec3(0.f), vector_end = vec3(0.f, 0.5f, 0.f);
 
@@ -353,22 +1004,88 @@ public:
     ivec2 prevWindowPos = ivec2(200, 200);
     ivec2 prevWindowSize = ivec2(1000, 600);
     int sidebarWidth = 0;
-    bool updateBufferSize = false;
     double lastMousePress = 0.0;
     bool doubleClickPressed = false;
     bool rightClickPending = false;
     bool rightClickPressed = false;
     float dpi_scale = 1.f;
-    int ssaa_factor = 3; // change to 3 when enabling SSAA by default
-    bool ssaa = true;
-    bool ssaa_enabled_by_user = false;
+    float render_scale = 3.f; // of the supersampled frame to the window
+    int aa_mode = SSAA;
+    int msaa_samples = 4;
     int frameCount = 0;
-    std::vector<double> fps_history = std::vector<double>(5, 0.0);
 
-    GLuint shaderProgram;
-    GLuint VAO, VBO, EBO;
+    // the resolution controller walks quality_levels to keep the GPU time of
+    // a frame within target_frame_ms, up to the last level under SSAA
+    struct QualityLevel {
+        float render_scale;
+        float res_scale;    // of every graph's grid_res
+    };
+    static constexpr QualityLevel quality_levels[]{
+        { 1.f, 0.5f }, { 1.f, 0.7f }, { 1.f, 1.f },
+        { 1.25f, 1.f }, { 1.5f, 1.f }, { 1.75f, 1.f }, { 2.f, 1.f },
+        { 2.25f, 1.f }, { 2.5f, 1.f }, { 2.75f, 1.f }, { 3.f, 1.f },
+    };
+    static constexpr int full_resolution_level = 2;
+    bool dynamic_resolution = true;
+    float target_frame_ms = 16.f;
+
+    // with redraw_on_demand the main loop sleeps in glfwWaitEventsTimeout
+    // whenever the last frame had nothing in motion and no input arrived
+    // for redraw_after_input frames, enough for ImGui to settle
+    static constexpr int redraw_after_input = 3;
+    bool redraw_on_demand = true;
+    int redraw_frames = redraw_after_input;
+    int quality_level = std::size(quality_levels) - 1;
+    float res_scale = 1.f;
+    double gpu_frame_ms = 0.0;     // smoothed
+    double qualityTimestamp = 0.0; // last change of quality_level
+    GLuint frameQueries[2];
+
+    GLuint shaderProgram, reduceProgram, quadtreeProgram, fieldProgram;
+    GLuint triangleTable;   // triang, for marchingcubes.glsl
+    GLuint VAO, VBO, graphVAO;
+    GLuint vectorProgram, vectorVAO, vectorMesh, vectorInstances;
+    GLuint lineProgram;
+    GLuint contourProgram, contourLineProgram;
+    GLsizei vector_vertices = 0;
+    std::vector<VectorInstance> vectors; // queued for draw_vectors
+    GLuint reduceBuffers[2];
     GLuint FBO, gridSSBO;
-    GLuint depthMap, frameTex, prevZBuffer, posBuffer, kernelBuffer, sliderBuffer;
+    std::vector<float> slider_values;
+    GLuint depthMap, frameTex, pickTex, sliderBuffer;
+    GLuint msaaFBO, msaaColor, msaaPick, msaaDepth; // rendered into instead of FBO under MSAA, resolved into it
+    GLuint downsampleFBO, downsampleTex;    // SSAA frame filtered horizontally only
+    GLuint historyFBO[2], historyTex[2];    // TAA accumulation, read and written alternately
+    bool history_valid = false;
+    int history_frames = 0;                 // accumulated since the history was last reset
+    mat4 history_vpmat{};                   // unjittered, of the frame the history was left by
+
+    // the texel of pickTex under the cursor is copied into a ring of small
+    // buffers after every frame and read back once its fence has signaled,
+    // usually a frame later, instead of stalling on the frame just drawn.
+    // pick holds the latest one read, pick_view the centerPos.xy and zoom
+    // it was drawn with
+    static constexpr int pick_slots = 3;
+    GLuint pickBuffers[pick_slots];
+    GLsync pickFences[pick_slots]{};
+    vec4 pickViews[pick_slots]{};
+    int pick_next = 0;
+    ivec2 pick_cursor{ -1 }; // of the last request, repeated only while the frame changes
+    GLuint pick[2]{};
+    vec4 pick_view{};
+
+    // the evaluated lattice points around a pick of a graph the cpu backend
+    // cannot evaluate again, copied from its grid behind the texel of a
+    // later request, so a pick or two behind the cursor
+    struct PickCell {
+        int graph = 0;       // 0 for none
+        vec2 p{};            // picked x and y, unused for a parametric surface
+        vec2 t{};            // of p between the corners
+        GridPoint points[4]; // corners (0, 0), (1, 0), (0, 1), (1, 1)
+    };
+    PickCell pickCells[pick_slots]{};
+    PickCell pick_cell{};    // the latest one read
+    GLuint cell_pick[2]{};   // the pick the latest cell was requested for
 
     void check_for_errors(GLuint shader) {
         int success;
@@ -380,6 +1097,15 @@ public:
             throw compilation_error(infoLog);
         }
     };
+
+    // built-in programs cannot fail to compile on a conforming driver, a
+    // failure is reported the same way as check_for_errors does
+    GLuint acquire_program(std::initializer_list<std::pair<GLenum, const char*>> stages) {
+        static std::string log;
+        GLuint program = program_cache.acquire(stages, log);
+        if (program == 0) throw compilation_error(log.data());
+        return program;
+    }
     
     Trisualizer() {
         glfwInit();
@@ -454,6 +1180,11 @@ public:
         glfwSetWindowSizeCallback(window, on_windowResize);
         glfwSetMouseButtonCallback(window, on_mouseButton);
         glfwSetKeyCallback(window, on_keyPress);
+        // only ImGui consumes these, it chains to them once installed
+        glfwSetCharCallback(window, [](GLFWwindow* window, unsigned int) { request_redraw(window); });
+        glfwSetWindowFocusCallback(window, [](GLFWwindow* window, int) { request_redraw(window); });
+        glfwSetCursorEnterCallback(window, [](GLFWwindow* window, int) { request_redraw(window); });
+        glfwSetWindowRefreshCallback(window, request_redraw);
 
         auto icon = b::embed<"assets/main.bmp">();
         uint8_t pixels[32 * 32 * 4];
@@ -506,31 +1237,52 @@ public:
         glDebugMessageCallback(glMessageCallback, nullptr);
 #endif
         b::EmbedInternal::EmbeddedFile embed;
-        const char* content;
-        int length;
 
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        embed = b::embed<"shaders/vertex.glsl">();
-        content = embed.data();
-        length = embed.length();
-        glShaderSource(vertexShader, 1, &content, NULL);
-        glCompileShader(vertexShader);
-        check_for_errors(vertexShader);
+        std::string cache_dir;
+#ifdef PLATFORM_WINDOWS
+        if (const char* local = std::getenv("LOCALAPPDATA")) cache_dir = std::string(local) + "/Trisualizer/shader_cache";
+#else
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME")) cache_dir = std::string(xdg) + "/trisualizer/shaders";
+        else if (const char* home = std::getenv("HOME")) cache_dir = std::string(home) + "/.cache/trisualizer/shaders";
+#endif
+        if (!cache_dir.empty()) program_cache.open_disk_cache(cache_dir);
+
+        // definitions are compiled while typing, off the render loop
+        if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+            program_cache.use_parallel_compile(reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR")));
+        }
+        else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+            program_cache.use_parallel_compile(reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB")));
+        }
+        else {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            compileWindow = glfwCreateWindow(1, 1, "", NULL, window);
+            if (compileWindow) program_cache.start_worker([this] { glfwMakeContextCurrent(compileWindow); });
+        }
 
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        embed = b::embed<"shaders/vertex.glsl">();
+        std::string vertexSource(embed.data(), embed.length());
         embed = b::embed<"shaders/fragment.glsl">();
-        content = embed.data();
-        length = embed.length();
-        glShaderSource(fragmentShader, 1, &content, NULL);
-        glCompileShader(fragmentShader);
-        check_for_errors(fragmentShader);
-
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        glDeleteShader(fragmentShader);
-        glDeleteShader(vertexShader);
+        std::string fragmentSource(embed.data(), embed.length());
+        shaderProgram = acquire_program({ { GL_VERTEX_SHADER, vertexSource.c_str() }, { GL_FRAGMENT_SHADER, fragmentSource.c_str() } });
+
+        embed = b::embed<"shaders/reduce.glsl">();
+        std::string reduceSource(embed.data(), embed.length());
+        reduceProgram = acquire_program({ { GL_COMPUTE_SHADER, reduceSource.c_str() } });
+        glGenBuffers(2, reduceBuffers);
+
+        embed = b::embed<"shaders/quadtree.glsl">();
+        std::string quadtreeSource(embed.data(), embed.length());
+        quadtreeProgram = acquire_program({ { GL_COMPUTE_SHADER, quadtreeSource.c_str() } });
+
+        embed = b::embed<"shaders/vectorfield.glsl">();
+        std::string fieldSource(embed.data(), embed.length());
+        fieldProgram = acquire_program({ { GL_COMPUTE_SHADER, fieldSource.c_str() } });
+
+        glGenBuffers(1, &triangleTable);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleTable);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(triang), triang, GL_STATIC_DRAW);
+
         glUseProgram(shaderProgram);
 
         glGenBuffers(1, &gridSSBO);
@@ -538,39 +1290,14 @@ public:
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gridSSBO);
         glShaderStorageBlockBinding(shaderProgram, glGetProgramResourceIndex(shaderProgram, GL_SHADER_STORAGE_BLOCK, "gridbuffer"), 0);
 
-        glGenBuffers(1, &posBuffer);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, posBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 6 * 700 * dpi_scale * 600 * dpi_scale * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, posBuffer);
-        glShaderStorageBlockBinding(shaderProgram, glGetProgramResourceIndex(shaderProgram, GL_SHADER_STORAGE_BLOCK, "posbuffer"), 1);
-
-        const float radius = 3.f;
-        auto gaussian = [](float x, float mu, float sigma) -> float {
-            const float a = (x - mu) / sigma;
-            return std::exp(-0.5 * a * a);
-        };
-        const float sigma = radius / 2.f;
-        int rowLength = 2 * radius + 1;
-        std::vector<float> kernel(rowLength * rowLength);
-        float sum = 0;
-        for (uint64_t row = 0; row < rowLength; row++) {
-            for (uint64_t col = 0; col < rowLength; col++) {
-                float x = gaussian(row, radius, sigma) * gaussian(col, radius, sigma);
-                kernel[row * rowLength + col] = x;
-                sum += x;
-            }
+        glGenBuffers(pick_slots, pickBuffers);
+        for (GLuint buffer : pickBuffers) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(pick) + sizeof(PickCell::points), nullptr, GL_STREAM_READ);
         }
-        for (uint64_t row = 0; row < rowLength; row++) {
-            for (uint64_t col = 0; col < rowLength; col++) {
-                kernel[row * rowLength + col] /= sum;
-            }
-        }
-        glGenBuffers(1, &kernelBuffer);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, kernelBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, kernelBuffer);
-        glShaderStorageBlockBinding(shaderProgram, glGetProgramResourceIndex(shaderProgram, GL_SHADER_STORAGE_BLOCK, "kernel"), 2);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, kernel.size() * sizeof(float), kernel.data(), GL_STATIC_DRAW);
-        glUniform1i(glGetUniformLocation(shaderProgram, "radius"), ssaa_factor);
+
+        glUniform1f(glGetUniformLocation(shaderProgram, "scale"), render_scale);
+        glGenQueries(2, frameQueries);
 
         glGenBuffers(1, &sliderBuffer);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, sliderBuffer);
@@ -595,15 +1322,20 @@ public:
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
 
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        // graphs are drawn without vertex attributes, positions come from gridbuffer
+        glGenVertexArrays(1, &graphVAO);
+        init_vectors();
+        init_lineintegral();
+        init_contours();
+        glUseProgram(shaderProgram);
 
         glGenFramebuffers(1, &FBO);
         glBindFramebuffer(GL_FRAMEBUFFER, FBO);
 
         glGenTextures(1, &depthMap);
         glBindTexture(GL_TEXTURE_2D, depthMap);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 1000 * ssaa_factor * dpi_scale, 600 * ssaa_factor * dpi_scale, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // 32F throughout, depth is blitted between these and msaaDepth
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, 1000 * render_scale * dpi_scale, 600 * render_scale * dpi_scale, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -612,58 +1344,295 @@ public:
 
         glGenTextures(1, &frameTex);
         glBindTexture(GL_TEXTURE_2D, frameTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 1000 * ssaa_factor * dpi_scale, 600 * ssaa_factor * dpi_scale, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1000 * render_scale * dpi_scale, 600 * render_scale * dpi_scale, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        // linear for FXAA's taps between texels, the other filters sample texel centers
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameTex, 0);
 
-        glGenTextures(1, &prevZBuffer);
-        glBindTexture(GL_TEXTURE_2D, prevZBuffer);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 1000 * ssaa_factor * dpi_scale, 600 * ssaa_factor * dpi_scale, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // graph index and grid coordinates of the front-most pickable
+        // fragment, packed by fragment.glsl, see pick_index; 0 where there
+        // is no graph
+        glGenTextures(1, &pickTex);
+        glBindTexture(GL_TEXTURE_2D, pickTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, 1000 * render_scale * dpi_scale, 600 * render_scale * dpi_scale, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, pickTex, 0);
+        const GLenum attachments[]{ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        // only render_graph writes picks, other programs leave the attachment undefined
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        // every attachment needs the same count, integer ones may support fewer
+        GLint max_integer_samples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &msaa_samples);
+        glGetIntegerv(GL_MAX_INTEGER_SAMPLES, &max_integer_samples);
+        msaa_samples = std::min({ msaa_samples, max_integer_samples, 4 });
+        glGenFramebuffers(1, &msaaFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, msaaFBO);
+        glGenRenderbuffers(1, &msaaColor);
+        glGenRenderbuffers(1, &msaaDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa_samples, GL_RGBA8, 1, 1);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, msaaColor);
+        glGenRenderbuffers(1, &msaaPick);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaPick);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa_samples, GL_RG32UI, 1, 1);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, msaaPick);
+        glDrawBuffers(2, attachments);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa_samples, GL_DEPTH_COMPONENT32F, 1, 1);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, msaaDepth);
+
+        glGenFramebuffers(1, &downsampleFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, downsampleFBO);
+        glGenTextures(1, &downsampleTex);
+        glBindTexture(GL_TEXTURE_2D, downsampleTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 1000 * dpi_scale, 600 * render_scale * dpi_scale, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, downsampleTex, 0);
+
+        glGenFramebuffers(2, historyFBO);
+        glGenTextures(2, historyTex);
+        for (int i = 0; i < 2; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, historyFBO[i]);
+            glBindTexture(GL_TEXTURE_2D, historyTex[i]);
+            // alpha holds how many frames were accumulated
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 1, 1, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTex[i], 0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
 
-        graphs.push_back(Graph(0, TangentPlane, "plane_params[0]+plane_params[1]*(x-plane_params[2])+plane_params[3]*(y-plane_params[4])", 100, vec4(0.f), vec4(0.f), false, gridSSBO, EBO));
-        graphs[0].setup();
+        graphs.push_back(Graph(0, TangentPlane, "plane_params[0]+plane_params[1]*(x-plane_params[2])+plane_params[3]*(y-plane_params[4])", 100, vec4(0.f), vec4(0.f), false));
         graphs[0].upload_definition(sliders);
-        graphs.push_back(Graph(1, UserDefined, "sin(x * y)", 500, colors[0], colors[1], true, gridSSBO, EBO));
-        graphs[1].setup();
+        graphs.push_back(Graph(1, UserDefined, "sin(x * y)", 500, colors[0], colors[1], true));
         graphs[1].upload_definition(sliders);
 
         mainloop();
     }
 private:
+    static inline void request_redraw(GLFWwindow* window) {
+        Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
+    }
+
     static inline void on_windowResize(GLFWwindow* window, int width, int height) {
         Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
+        GLsizei w = width * app->render_scale * app->dpi_scale, h = height * app->render_scale * app->dpi_scale;
         glBindTexture(GL_TEXTURE_2D, app->depthMap);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width * app->ssaa_factor * app->dpi_scale, height * app->ssaa_factor * app->dpi_scale, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
         glBindTexture(GL_TEXTURE_2D, app->frameTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width * app->ssaa_factor * app->dpi_scale, height * app->ssaa_factor * app->dpi_scale, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glBindTexture(GL_TEXTURE_2D, app->prevZBuffer);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width * app->ssaa_factor * app->dpi_scale, height * app->ssaa_factor * app->dpi_scale, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->posBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 6 * (size_t)(width - app->sidebarWidth) * app->dpi_scale * height * app->dpi_scale * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, app->pickTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, w, h, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL);
+        // the targets of the other modes shrink to nothing
+        bool msaa = app->aa_mode == MSAA, ssaa = app->aa_mode == SSAA;
+        glBindRenderbuffer(GL_RENDERBUFFER, app->msaaColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, app->msaa_samples, GL_RGBA8, msaa ? w : 1, msaa ? h : 1);
+        glBindRenderbuffer(GL_RENDERBUFFER, app->msaaPick);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, app->msaa_samples, GL_RG32UI, msaa ? w : 1, msaa ? h : 1);
+        glBindRenderbuffer(GL_RENDERBUFFER, app->msaaDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, app->msaa_samples, GL_DEPTH_COMPONENT32F, msaa ? w : 1, msaa ? h : 1);
+        glBindTexture(GL_TEXTURE_2D, app->downsampleTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, ssaa ? GLsizei(width * app->dpi_scale) : 1, ssaa ? h : 1, 0, GL_RGBA, GL_FLOAT, NULL);
+        bool taa = app->aa_mode == TAA;
+        for (GLuint tex : app->historyTex) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, taa ? w : 1, taa ? h : 1, 0, GL_RGBA, GL_FLOAT, NULL);
+        }
+        app->history_valid = false;
+    }
+
+    // reads the GPU time of the frame before last and moves a level along
+    // quality_levels once it has been outside the 80-110% band around
+    // target_frame_ms; a step up must also fit the budget by its estimated
+    // cost. Levels change at most twice a second, each one a fixed size so
+    // the framebuffers are only reallocated when the level does
+    void update_quality(double currentTime) {
+        GLuint query = frameQueries[frameCount % 2];
+        GLint available = 0;
+        if (frameCount > 2) glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            double ms = ns / 1e6;
+            gpu_frame_ms = gpu_frame_ms == 0.0 ? ms : gpu_frame_ms * 0.9 + ms * 0.1;
+        }
+
+        int top = aa_mode == SSAA ? (int)std::size(quality_levels) - 1 : full_resolution_level;
+        int level = std::min(quality_level, top);
+        if (!dynamic_resolution) level = top;
+        else if (currentTime - qualityTimestamp > 0.5 && gpu_frame_ms > 0.0) {
+            if (gpu_frame_ms > target_frame_ms * 1.1 && level > 0) level--;
+            else if (level < top) {
+                const QualityLevel& a = quality_levels[level];
+                const QualityLevel& b = quality_levels[level + 1];
+                // fragments grow with the square of render_scale, grid points with that of res_scale
+                double cost = (b.render_scale * b.render_scale * b.res_scale * b.res_scale) / (a.render_scale * a.render_scale * a.res_scale * a.res_scale);
+                if (gpu_frame_ms * cost < target_frame_ms * 0.8) level++;
+            }
+        }
+        if (level == quality_level) return;
+        quality_level = level;
+        qualityTimestamp = currentTime;
+        res_scale = quality_levels[level].res_scale;
+        if (render_scale != quality_levels[level].render_scale) {
+            render_scale = quality_levels[level].render_scale;
+            int width, height;
+            glfwGetWindowSize(window, &width, &height);
+            on_windowResize(window, width, height);
+            glUseProgram(shaderProgram);
+            glUniform1f(glGetUniformLocation(shaderProgram, "scale"), render_scale);
+        }
+    }
+
+    // graph of the latest pick, whose index fragment.glsl splits over the
+    // top bytes of both channels, below them are its coordinates
+    int pick_index() const {
+        return pick[0] >> 24 | (pick[1] >> 24) << 8;
+    }
+
+    // graphs whose picked point is interpolated from the lattice points
+    // around it rather than evaluated again
+    bool picks_cell(const Graph& g) const {
+        return g.form == Parametric || g.form == Explicit && !g.cpu_ready;
+    }
+
+    // true while the latest pick is of such a graph and no cell has been
+    // requested for it yet
+    bool cell_outdated() const {
+        int index = pick_index();
+        return index > 0 && index < graphs.size() && picks_cell(graphs[index])
+            && (cell_pick[0] != pick[0] || cell_pick[1] != pick[1]);
+    }
+
+    // queues the copy of the texel of pickTex under the cursor, in window
+    // coordinates, from the frame just drawn into FBO, and behind it the
+    // cell of the latest pick read. A slot whose readback is still pending
+    // is given up
+    void request_pick(int x, int y, int wHeight) {
+        int slot = pick_next;
+        pick_next = (pick_next + 1) % pick_slots;
+        if (pickFences[slot]) glDeleteSync(pickFences[slot]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pickBuffers[slot]);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glReadPixels(render_scale * x * dpi_scale, render_scale * (wHeight - y) * dpi_scale, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pickViews[slot] = vec4(centerPos.x, centerPos.y, zoomx, zoomy);
+        request_cell(slot);
+        pickFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // copies the four lattice points evaluated at the graph's current
+    // stride around the latest pick into slot, after its texel
+    void request_cell(int slot) {
+        PickCell& cell = pickCells[slot];
+        cell = {};
+        int index = pick_index();
+        if (index == 0 || index >= graphs.size() || !picks_cell(graphs[index])) return;
+        const Graph& g = graphs[index];
+        vec2 uv = vec2(pick[0] & 0xFFFFFF, pick[1] & 0xFFFFFF) / float(0xFFFFFF);
+        cell.graph = index;
+        // in lattice indices; a point of an explicit graph is at its cell's
+        // center, those of a parametric surface span the ends of its ranges
+        vec2 f = uv * float(g.eval_res - 1);
+        if (g.form == Explicit) {
+            cell.p = vec2(pick_view) + (uv - 0.5f) * vec2(pick_view.z, pick_view.w);
+            f = cell.p / vec2(zoomx, zoomy) * float(g.eval_res) - 0.5f;
+        }
+        ivec2 first(g.align(g.origin.x), g.align(g.origin.y));
+        ivec2 last = first + (g.mesh_res() - 1) * g.stride;
+        ivec2 corner = clamp(ivec2(floor(f / float(g.stride))) * g.stride, first, max(first, last - g.stride));
+        cell.t = clamp((f - vec2(corner)) / float(g.stride), 0.f, 1.f);
+        glBindBuffer(GL_COPY_READ_BUFFER, g.SSBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, pickBuffers[slot]);
+        for (int k = 0; k < 4; k++) {
+            ivec2 i = min(corner + ivec2(k & 1, k >> 1) * g.stride, last) - g.origin;
+            ivec2 s = (g.wrap + i) % g.eval_res;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ((size_t)s.y * g.eval_res + s.x) * sizeof(GridPoint),
+                sizeof(pick) + k * sizeof(GridPoint), sizeof(GridPoint));
+        }
+        memcpy(cell_pick, pick, sizeof(pick));
+    }
+
+    // reads every pick whose copy has completed into pick, and its cell
+    // into pick_cell, oldest first
+    void poll_picks() {
+        for (int i = 0; i < pick_slots; i++) {
+            int slot = (pick_next + i) % pick_slots;
+            if (!pickFences[slot]) continue;
+            GLenum status = glClientWaitSync(pickFences[slot], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+            glDeleteSync(pickFences[slot]);
+            pickFences[slot] = nullptr;
+            glBindBuffer(GL_COPY_READ_BUFFER, pickBuffers[slot]);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(pick), pick);
+            pick_view = pickViews[slot];
+            if (pickCells[slot].graph == 0) continue;
+            pick_cell = pickCells[slot];
+            glGetBufferSubData(GL_COPY_READ_BUFFER, sizeof(pick), sizeof(pick_cell.points), pick_cell.points);
+        }
+    }
+
+    // unpacks pick into the graph and the surface point under it, false
+    // over no graph. Only the picked point is evaluated again, by the cpu
+    // backend; a graph it cannot evaluate, and a parametric surface, is
+    // interpolated over pick_cell, and false until one of it has arrived
+    bool resolve_pick(int& index, vec3& pos, vec2& partials) {
+        index = pick_index();
+        if (index == 0 || index >= graphs.size()) return false;
+        const Graph& g = graphs[index];
+        if (picks_cell(g)) {
+            if (pick_cell.graph != index) return false;
+            const GridPoint* c = pick_cell.points;
+            vec2 t = pick_cell.t;
+            vec4 value = mix(mix(c[0].value, c[1].value, t.x), mix(c[2].value, c[3].value, t.x), t.y);
+            if (g.form == Parametric) {
+                vec4 normal = mix(mix(c[0].normal, c[1].normal, t.x), mix(c[2].normal, c[3].normal, t.x), t.y);
+                pos = vec3(value);
+                partials = vec2(value.w, normal.w);
+            }
+            else {
+                pos = vec3(pick_cell.p, value.x * zoomz);
+                partials = vec2(value.z, value.w);
+            }
+            return true;
+        }
+        vec2 uv = vec2(pick[0] & 0xFFFFFF, pick[1] & 0xFFFFFF) / float(0xFFFFFF);
+        vec2 p = vec2(pick_view) + (uv - 0.5f) * vec2(pick_view.z, pick_view.w);
+        float point[CpuEvaluator::point_floats];
+        g.cpu.evaluate(point, { 1, zoomx, zoomy, zoomz, p.x, p.y }, slider_values, g.plane_params);
+        pos = vec3(p, point[0] * zoomz);
+        partials = vec2(point[2], point[3]);
+        return true;
+    }
+
+    bool picks_pending() const {
+        for (GLsync fence : pickFences)
+            if (fence) return true;
+        return false;
     }
 
     static inline void on_mouseButton(GLFWwindow* window, int button, int action, int mods) {
         Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
         switch (button) {
         case GLFW_MOUSE_BUTTON_LEFT:
             app->rightClickPressed = false;
             switch (action) {
-            case GLFW_RELEASE:
-                if (app->updateBufferSize) {
-                    int width, height;
-                    glfwGetWindowSize(window, &width, &height);
-                    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->posBuffer);
-                    glBufferData(GL_SHADER_STORAGE_BUFFER, 6ull * (width - app->sidebarWidth) * app->dpi_scale * height * app->dpi_scale * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-                    app->updateBufferSize = false;
-                }
-                break;
             case GLFW_PRESS:
                 if (app->tangent_plane)
                     app->apply_tangent_plane = true;
@@ -688,6 +1657,7 @@ private:
 
     static inline void on_mouseScroll(GLFWwindow* window, double x, double y) {
         Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
         if (ImGui::GetIO().WantCaptureMouse) return;
         if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS) {
             app->graph_size *= pow(0.9f, -y);
@@ -701,6 +1671,7 @@ private:
 
     static inline void on_mouseMove(GLFWwindow* window, double x, double y) {
         Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
         if (ImGui::GetIO().WantCaptureMouse && !app->rightClickPressed) return;
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
             float xoffset = x - app->mousePos.x;
@@ -717,6 +1688,7 @@ private:
 
     static inline void on_keyPress(GLFWwindow* window, int key, int scancode, int action, int mods) {
         Trisualizer* app = static_cast<Trisualizer*>(glfwGetWindowUserPointer(window));
+        app->redraw_frames = redraw_after_input;
         float angle_r = app->phi * M_PI / 180.f;
         switch (action) {
         case GLFW_PRESS:
@@ -861,10 +1833,7 @@ private:
         //     s.used_in.resize(graphs.size(), false);
         // }
         // for (Graph& g : graphs) {
-        //     g.SSBO = gridSSBO;
-        //     g.EBO = EBO;
         //     g.upload_definition(sliders);
-        //     g.setup();
         // }
 
         // in.read(&buf[0], 2 * sizeof(float));
@@ -897,36 +1866,34 @@ private:
         // in.close();
     }
 
-    void draw_lineintegral(vec3 color, mat4 view, mat4 proj) {
-        b::EmbedInternal::EmbeddedFile embed;
-        const char* content;
-        int length;
-
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    // the curtain of a line integral between the path and the graph over it,
+    // drawn straight from the samples compute_lineintegral leaves in lineSamples
+    void init_lineintegral() {
         const char* vertexSource = R"glsl(
 #version 460 core
 
-layout (location = 0) in vec3 aPos;
+layout(std430, binding = 6) readonly buffer sbuf3 {
+	float samples[];
+};
 
 uniform mat4 view;
 uniform mat4 proj;
-
-out vec3 fragPos;
-out vec3 normal;
+uniform float zoomx;
+uniform float zoomy;
+uniform float zoomz;
+uniform float graph_size;
+uniform vec3 centerPos;
 
 void main() {
-    fragPos = aPos;
-    gl_Position = proj * view * vec4(aPos, 1.f);
+    // even vertices on the graph over the path, odd ones on the path itself
+    int i = gl_VertexID / 2;
+    vec3 v = vec3(samples[i * 4 + 2], samples[i * 4 + 3], gl_VertexID % 2 == 0 ? samples[i * 4] : 0.f) - centerPos;
+    gl_Position = proj * view * vec4(graph_size * v.x / zoomx, v.z / zoomz * graph_size, graph_size * v.y / zoomy, 1.f);
 })glsl";
-        glShaderSource(vertexShader, 1, &vertexSource, NULL);
-        glCompileShader(vertexShader);
-        check_for_errors(vertexShader);
 
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
         const char* fragmentSource = R"glsl(
 #version 460 core
 
-in vec3 fragPos;
 out vec4 fragColor;
 
 uniform vec3 color;
@@ -934,149 +1901,189 @@ uniform vec3 color;
 void main() {
     fragColor = vec4(color, 1.0);
 })glsl";
-        glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-        glCompileShader(fragmentShader);
-        check_for_errors(fragmentShader);
+        lineProgram = acquire_program({ { GL_VERTEX_SHADER, vertexSource }, { GL_FRAGMENT_SHADER, fragmentSource } });
+        glGenBuffers(1, &lineSamples);
+    }
 
-        GLuint vectorShaderProgram = glCreateProgram();
-        glAttachShader(vectorShaderProgram, vertexShader);
-        glAttachShader(vectorShaderProgram, fragmentShader);
-        glLinkProgram(vectorShaderProgram);
-        glDeleteShader(fragmentShader);
-        glDeleteShader(vertexShader);
-        glUseProgram(vectorShaderProgram);
+    void draw_lineintegral(vec3 color, mat4 view, mat4 proj) {
+        glUseProgram(lineProgram);
+        glUniformMatrix4fv(glGetUniformLocation(lineProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(glGetUniformLocation(lineProgram, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+        glUniform1f(glGetUniformLocation(lineProgram, "zoomx"), zoomx);
+        glUniform1f(glGetUniformLocation(lineProgram, "zoomy"), zoomy);
+        glUniform1f(glGetUniformLocation(lineProgram, "zoomz"), zoomz);
+        glUniform1f(glGetUniformLocation(lineProgram, "graph_size"), graph_size);
+        glUniform3fv(glGetUniformLocation(lineProgram, "centerPos"), 1, value_ptr(centerPos));
+        glUniform3fv(glGetUniformLocation(lineProgram, "color"), 1, value_ptr(color));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, lineSamples);
+        glBindVertexArray(graphVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, li_samplecount * 2);
 
-        GLuint vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glBindVertexArray(vao);
+        glUseProgram(shaderProgram);
+        glBindVertexArray(VAO);
+    }
 
+    // the segments contour.glsl appends to a graph's contourBuffer, drawn as
+    // lines with its drawbuffer's count and placed in the view; those past
+    // its capacity were not written, and they and the levels outside the
+    // view's box are left outside the clip volume
+    void init_contours() {
+        auto embed = b::embed<"shaders/contour.glsl">();
+        std::string contourSource(embed.data(), embed.length());
+        contourProgram = acquire_program({ { GL_COMPUTE_SHADER, contourSource.c_str() } });
 
-        for (int i = 0; i < li_samplecount; i++) {
-            vec3 cvu = to_worldspace(vec3(li_data[i * 3], li_data[i * 3 + 1], li_data[i * 3 + 2]));
-            vec3 cvd = to_worldspace(vec3(li_data[i * 3], li_data[i * 3 + 1], 0.f));
+        const char* vertexSource = R"glsl(
+#version 460 core
 
-            li_data_ws[i * 6 + 0] = cvu.x;
-            li_data_ws[i * 6 + 1] = cvu.y;
-            li_data_ws[i * 6 + 2] = cvu.z;
-            li_data_ws[i * 6 + 3] = cvd.x;
-            li_data_ws[i * 6 + 4] = cvd.y;
-            li_data_ws[i * 6 + 5] = cvd.z;
-        }
+layout(std430, binding = 14) readonly buffer contourbuffer {
+	vec4 points[];
+};
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, li_samplecount * 6 * sizeof(float), li_data_ws, GL_STATIC_DRAW);
+uniform mat4 view;
+uniform mat4 proj;
+uniform uint max_points;
+uniform vec2 lattice_shift; // of the world-snapped lattice from the view
+uniform float graph_size;
+uniform float center_height; // centerPos.z / zoomz
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
+out float onSurface;
 
-        glUniformMatrix4fv(glGetUniformLocation(vectorShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(vectorShaderProgram, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+void main() {
+    vec4 p = points[min(uint(gl_VertexID), max_points - 1)];
+    float height = p.y - center_height;
+    if (uint(gl_VertexID) >= max_points || abs(height) > 0.5f) {
+        gl_Position = vec4(2.f, 2.f, 2.f, 1.f);
+        onSurface = 0.f;
+        return;
+    }
+    vec3 world = graph_size * vec3(p.x + lattice_shift.x, p.w > 0.5f ? height : -0.5f, p.z + lattice_shift.y);
+    gl_Position = proj * view * vec4(world, 1.f);
+    // just in front of the surface it lies on, the scene keeps the greater depth
+    gl_Position.z += 1e-3f * gl_Position.w;
+    onSurface = p.w;
+})glsl";
 
-        glUniform3fv(glGetUniformLocation(vectorShaderProgram, "color"), 1, value_ptr(color));
+        const char* fragmentSource = R"glsl(
+#version 460 core
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, li_samplecount * 2);
+in float onSurface;
+out vec4 fragColor;
 
-        glDeleteProgram(vectorShaderProgram);
-        glDeleteBuffers(1, &vbo);
-        glDeleteVertexArrays(1, &vao);
+uniform vec3 color;
 
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+void main() {
+    fragColor = vec4(color * mix(0.6f, 0.35f, onSurface), 1.0);
+})glsl";
+        contourLineProgram = acquire_program({ { GL_VERTEX_SHADER, vertexSource }, { GL_FRAGMENT_SHADER, fragmentSource } });
     }
 
-    // TODO: add shadows under arrow
-    void draw_vector(vec3 start, vec3 end, vec3 color, mat4 view, mat4 proj, float thickness = 1.f) {
-        const float factor = graph_size / 1.3f;
-        float magnitude = distance(start, end);
-        float tip_height = clamp(magnitude / 2.f, 0.01f, 0.1f * factor) * thickness;
-        float bottom_radius = 0.01f * factor * thickness;
-        float top_radius = 0.03f * factor * thickness;
-        int segments = 20 * factor;
-        auto push = [](std::vector<float>& arr, vec3 v, vec3 normal) {
-            arr.push_back(v.x);
-            arr.push_back(v.y);
-            arr.push_back(v.z);
-            arr.push_back(normal.x);
-            arr.push_back(normal.y);
-            arr.push_back(normal.z);
-        };
-        std::vector<float> bottom_circle;
-        std::vector<float> cylinder;
-        std::vector<float> top_circle;
-        std::vector<float> conic_head;
-
-        vec3 bottom_normal = vec3(0,-1,0);
-        push(bottom_circle, vec3(0.f), bottom_normal);
-        for (float a = 0.f; a < 2.f * M_PI; a += 2.f * M_PI / segments) {
-            push(bottom_circle, vec3(bottom_radius * cos(a), 0.f, bottom_radius * sin(a)), bottom_normal);
+    // marches the squares of g's evaluated lattice for the levels of
+    // g.contour_levels and draws the segments, without leaving the gpu. The
+    // march is only repeated once the grid, its stride or the levels change
+    void draw_contours(Graph& g, mat4 view, mat4 proj) {
+        if (g.contourBuffer == 0) {
+            glGenBuffers(1, &g.contourBuffer);
+            glGenBuffers(1, &g.contourDraw);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.contourDraw);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
         }
-        push(bottom_circle, vec3(bottom_radius, 0.f, 0.f), bottom_normal);
 
-        for (float a = 0.f; a <= 2.f * M_PI; a += 2.f * M_PI / segments) {
-            vec3 normal = vec3(cos(a), 0.f, sin(a));
-            push(cylinder, bottom_radius * vec3(cos(a), 0.f, sin(a)), normal);
-            push(cylinder, vec3(bottom_radius * cos(a), magnitude - tip_height, bottom_radius * sin(a)), normal);
-        }
-        push(cylinder, vec3(bottom_radius, 0.f, 0.f), vec3(1.f, 0.f, 0.f));
-        push(cylinder, vec3(bottom_radius, magnitude - tip_height, 0.f), vec3(1.f, 0.f, 0.f));
-
-        vec3 top_normal = vec3(0, -1, 0);
-        push(top_circle, vec3(0.f, magnitude - tip_height, 0.f), top_normal);
-        for (float a = 0.f; a < 2.f * M_PI; a += 2.f * M_PI / segments) {
-            push(top_circle, vec3(top_radius * cos(a), magnitude - tip_height, top_radius * sin(a)), top_normal);
-        }
-        push(top_circle, vec3(top_radius, magnitude - tip_height, 0.f), top_normal);
-
-        auto normal_vec = [&](float a) {
-            float inc = atan(tip_height / top_radius);
-            return vec3(sin(inc) * cos(a), cos(inc), sin(inc) * sin(a));
-        };
-        for (float a = 0.f; a < 2.f * M_PI; a += 2.f * M_PI / segments) {
-            push(conic_head, vec3(0.f, magnitude, 0.f), normal_vec(a));
-            push(conic_head, vec3(top_radius * cos(a), magnitude - tip_height, top_radius * sin(a)), normal_vec(a));
+        Graph::ContourKey key{ g.stamp, g.origin, g.wrap, g.stride, g.contour_floor, g.contour_levels(zoomz, centerPos) };
+        if (key != g.contour_key) {
+            // a segment through every cell at every level, which saddles and
+            // steep graphs may exceed; those past it are dropped
+            GLuint cells = (g.mesh_res() - 1) * (g.mesh_res() - 1);
+            GLuint needed = std::min<size_t>(contour_points, (size_t)cells * key.levels.size() * (g.contour_floor ? 4 : 2));
+            if (g.contour_capacity < needed) {
+                g.contour_capacity = needed;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.contourBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, g.contour_capacity * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+            }
+            // no vertices yet, contour.glsl counts them up
+            const GLuint command[]{ 0, 1, 0, 0 };
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.contourDraw);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), command);
+
+            glUseProgram(contourProgram);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g.SSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, g.contourDraw);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, g.contourBuffer);
+            glUniform1i(glGetUniformLocation(contourProgram, "grid_res"), g.eval_res);
+            glUniform2i(glGetUniformLocation(contourProgram, "wrap"), g.wrap.x, g.wrap.y);
+            glUniform1i(glGetUniformLocation(contourProgram, "mesh_res"), g.mesh_res());
+            glUniform1i(glGetUniformLocation(contourProgram, "mesh_stride"), g.stride);
+            glUniform2i(glGetUniformLocation(contourProgram, "mesh_first"), g.align(g.origin.x) - g.origin.x, g.align(g.origin.y) - g.origin.y);
+            glUniform1f(glGetUniformLocation(contourProgram, "zoomz"), zoomz);
+            glUniform1fv(glGetUniformLocation(contourProgram, "levels"), key.levels.size(), key.levels.data());
+            glUniform1i(glGetUniformLocation(contourProgram, "level_count"), key.levels.size());
+            glUniform1i(glGetUniformLocation(contourProgram, "floor_copy"), g.contour_floor);
+            glUniform1ui(glGetUniformLocation(contourProgram, "max_points"), g.contour_capacity);
+            GLuint groups = (g.mesh_res() - 1 + tile_size - 1) / tile_size;
+            glDispatchCompute(groups, groups, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+            g.contour_key = std::move(key);
         }
-        push(conic_head, vec3(0.f, magnitude, 0.f), normal_vec(0.f));
-        push(conic_head, vec3(top_radius, magnitude - tip_height, 0.f), normal_vec(0.f));
+        if (g.contour_capacity == 0) return;
+
+        glUseProgram(contourLineProgram);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, g.contourBuffer);
+        glUniformMatrix4fv(glGetUniformLocation(contourLineProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(glGetUniformLocation(contourLineProgram, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+        glUniform1ui(glGetUniformLocation(contourLineProgram, "max_points"), g.contour_capacity);
+        glUniform2fv(glGetUniformLocation(contourLineProgram, "lattice_shift"), 1, value_ptr(g.lattice_shift(zoomx, zoomy, centerPos)));
+        glUniform1f(glGetUniformLocation(contourLineProgram, "graph_size"), graph_size);
+        glUniform1f(glGetUniformLocation(contourLineProgram, "center_height"), centerPos.z / zoomz);
+        glUniform3fv(glGetUniformLocation(contourLineProgram, "color"), 1, value_ptr(vec3(g.color)));
+        glBindVertexArray(graphVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g.contourDraw);
+        glDrawArraysIndirect(GL_LINES, nullptr);
 
+        glUseProgram(shaderProgram);
+        glBindVertexArray(VAO);
+    }
 
-        int success;
-        char infoLog[512];
-
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    // the unit arrow of draw_vectors: per vertex the cosine and sine of its
+    // angle around the shaft, its level (0 shaft base, 1 shaft top, 2 head
+    // base, 3 tip) and its surface (0 base disc, 1 shaft, 2 head disc, 3 cone)
+    void init_vectors() {
         const char* vertexSource = R"glsl(
 #version 460 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aVertex;
+layout (location = 1) in mat4 model; // rotation and translation only
+layout (location = 5) in vec4 shape; // length, tip height, shaft radius, head radius
+layout (location = 6) in vec3 aColor;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
 
 out vec3 fragPos;
 out vec3 normal;
+out vec3 color;
 
 void main() {
-    fragPos = vec3(model * vec4(aPos, 1.f));
-    normal = mat3(transpose(inverse(model))) * aNormal;
+    int level = int(aVertex.z), surface = int(aVertex.w);
+    float neck = shape.x - shape.y;
+    float heights[4] = float[](0.f, neck, neck, shape.x);
+    float radii[4] = float[](shape.z, shape.z, shape.w, 0.f);
+    float inc = atan(shape.y / shape.w);
+    vec3 normals[4] = vec3[](vec3(0.f, -1.f, 0.f), vec3(aVertex.x, 0.f, aVertex.y), vec3(0.f, -1.f, 0.f), vec3(sin(inc) * aVertex.x, cos(inc), sin(inc) * aVertex.y));
+    fragPos = vec3(model * vec4(aVertex.x * radii[level], heights[level], aVertex.y * radii[level], 1.f));
+    normal = mat3(model) * normals[surface];
+    color = aColor;
     gl_Position = proj * view * vec4(fragPos, 1.f);
 })glsl";
-        glShaderSource(vertexShader, 1, &vertexSource, NULL);
-        glCompileShader(vertexShader);
-        check_for_errors(vertexShader);
 
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
         const char* fragmentSource = R"glsl(
 #version 460 core
 
 in vec3 fragPos;
 in vec3 normal;
+in vec3 color;
 
 out vec4 fragColor;
 
-uniform vec3 color;
 uniform vec3 lightPos;
 
 void main() {
@@ -1090,17 +2097,57 @@ void main() {
 
     fragColor = vec4(ambient + diffuse, 1.f);
 })glsl";
-        glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-        glCompileShader(fragmentShader);
-        check_for_errors(fragmentShader);
-
-        GLuint vectorShaderProgram = glCreateProgram();
-        glAttachShader(vectorShaderProgram, vertexShader);
-        glAttachShader(vectorShaderProgram, fragmentShader);
-        glLinkProgram(vectorShaderProgram);
-        glDeleteShader(fragmentShader);
-        glDeleteShader(vertexShader);
-        glUseProgram(vectorShaderProgram);
+        vectorProgram = acquire_program({ { GL_VERTEX_SHADER, vertexSource }, { GL_FRAGMENT_SHADER, fragmentSource } });
+
+        const int segments = 24;
+        std::vector<vec4> mesh;
+        for (int i = 0; i < segments; i++) {
+            float a0 = 2.f * M_PI * i / segments, a1 = 2.f * M_PI * (i + 1) / segments;
+            vec2 c0 = vec2(cos(a0), sin(a0)), c1 = vec2(cos(a1), sin(a1));
+            mesh.insert(mesh.end(), { vec4(0.f, 0.f, 0.f, 0.f), vec4(c0, 0.f, 0.f), vec4(c1, 0.f, 0.f) });
+            mesh.insert(mesh.end(), { vec4(c0, 0.f, 1.f), vec4(c0, 1.f, 1.f), vec4(c1, 0.f, 1.f) });
+            mesh.insert(mesh.end(), { vec4(c1, 0.f, 1.f), vec4(c0, 1.f, 1.f), vec4(c1, 1.f, 1.f) });
+            mesh.insert(mesh.end(), { vec4(0.f, 0.f, 2.f, 2.f), vec4(c0, 2.f, 2.f), vec4(c1, 2.f, 2.f) });
+            mesh.insert(mesh.end(), { vec4(c0, 3.f, 3.f), vec4(c0, 2.f, 3.f), vec4(c1, 2.f, 3.f) });
+        }
+        vector_vertices = (GLsizei)mesh.size();
+
+        glGenVertexArrays(1, &vectorVAO);
+        glBindVertexArray(vectorVAO);
+        glGenBuffers(1, &vectorMesh);
+        glBindBuffer(GL_ARRAY_BUFFER, vectorMesh);
+        glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(vec4), mesh.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), nullptr);
+
+        // instances come from binding 1, which draw_vector_instances points
+        // at the queued arrows or at a graph's vector field
+        glGenBuffers(1, &vectorInstances);
+        for (int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(1 + i);
+            glVertexAttribFormat(1 + i, 4, GL_FLOAT, GL_FALSE, offsetof(VectorInstance, model) + i * sizeof(vec4));
+            glVertexAttribBinding(1 + i, 1);
+        }
+        glEnableVertexAttribArray(5);
+        glVertexAttribFormat(5, 4, GL_FLOAT, GL_FALSE, offsetof(VectorInstance, shape));
+        glVertexAttribBinding(5, 1);
+        glEnableVertexAttribArray(6);
+        glVertexAttribFormat(6, 3, GL_FLOAT, GL_FALSE, offsetof(VectorInstance, color));
+        glVertexAttribBinding(6, 1);
+        glVertexBindingDivisor(1, 1);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    }
+
+    // TODO: add shadows under arrow
+    // queues an arrow from start to end for draw_vectors
+    void add_vector(vec3 start, vec3 end, vec3 color, float thickness = 1.f) {
+        const float factor = graph_size / 1.3f;
+        float magnitude = distance(start, end);
+        float tip_height = clamp(magnitude / 2.f, 0.01f, 0.1f * factor) * thickness;
+        float bottom_radius = 0.01f * factor * thickness;
+        float top_radius = 0.03f * factor * thickness;
 
         vec3 direction = normalize(end - start);
         vec3 defdir = vec3(0.f, 1.f, 0.f);
@@ -1109,49 +2156,84 @@ void main() {
         float angle = acos(clamp(dot(defdir, direction), -1.0f, 1.0f));
         mat4 rotationMatrix = rotate(mat4(1.f), angle, normalize(rotationAxis));
         mat4 modelMatrix = translate(mat4(1.f), start) * rotationMatrix;
-        glUniformMatrix4fv(glGetUniformLocation(vectorShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(vectorShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(vectorShaderProgram, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
-
-        glUniform3fv(glGetUniformLocation(vectorShaderProgram, "color"), 1, value_ptr(color));
-        glUniform3fv(glGetUniformLocation(vectorShaderProgram, "lightPos"), 1, value_ptr(light_pos));
-
-        unsigned int vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-
-        glBindVertexArray(vao);
-
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        glBufferData(GL_ARRAY_BUFFER, bottom_circle.size() * sizeof(float), bottom_circle.data(), GL_STATIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, bottom_circle.size() / 6);
-
-        glBufferData(GL_ARRAY_BUFFER, cylinder.size() * sizeof(float), cylinder.data(), GL_STATIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, cylinder.size() / 6);
+        vectors.push_back({ modelMatrix, vec4(magnitude, tip_height, bottom_radius, top_radius), vec4(color, 1.f) });
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, top_circle.size() * sizeof(float), top_circle.data(), GL_STATIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, top_circle.size() / 6);
+    // draws every queued arrow in one instanced call
+    void draw_vectors(mat4 view, mat4 proj) {
+        if (vectors.empty()) return;
+        glBindBuffer(GL_ARRAY_BUFFER, vectorInstances);
+        glBufferData(GL_ARRAY_BUFFER, vectors.size() * sizeof(VectorInstance), vectors.data(), GL_STREAM_DRAW);
+        draw_vector_instances(vectorInstances, (GLsizei)vectors.size(), view, proj);
+        vectors.clear();
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, conic_head.size() * sizeof(float), conic_head.data(), GL_STATIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, conic_head.size() / 6);
+    // count arrows of the VectorInstance array in buffer
+    void draw_vector_instances(GLuint buffer, GLsizei count, mat4 view, mat4 proj) {
+        glUseProgram(vectorProgram);
+        glUniformMatrix4fv(glGetUniformLocation(vectorProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(glGetUniformLocation(vectorProgram, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+        glUniform3fv(glGetUniformLocation(vectorProgram, "lightPos"), 1, value_ptr(light_pos));
 
-        glDeleteProgram(vectorShaderProgram);
-        glDeleteBuffers(1, &vbo);
-        glDeleteVertexArrays(1, &vao);
+        glBindVertexArray(vectorVAO);
+        glBindVertexBuffer(1, buffer, 0, sizeof(VectorInstance));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vector_vertices, count);
 
         glUseProgram(shaderProgram);
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
     }
 
-    std::pair<float, float> min_max(char var, const char* func, float rbegin, float rend, int samplesize, char* infoLog) {
-        unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    // fills g.fieldBuffer with an arrow of the gradient per cell of a
+    // field_res x field_res sub-lattice of the grid, without leaving the gpu
+    void update_vector_field(Graph& g) {
+        vec2 shift = g.lattice_shift(zoomx, zoomy, centerPos);
+        Graph::FieldKey key{ g.stamp, g.origin, g.stride, g.field_res, shift, centerPos.z / zoomz, g.color, g.secondary_color };
+        if (key == g.field_key) return;
+        g.field_key = key;
+        GLsizeiptr size = (GLsizeiptr)g.field_res * g.field_res * sizeof(VectorInstance);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.fieldBuffer);
+        if (g.field_capacity != size) {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            g.field_capacity = size;
+        }
+        glUseProgram(fieldProgram);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, g.fieldBuffer);
+        glUniform1i(glGetUniformLocation(fieldProgram, "grid_res"), g.eval_res);
+        glUniform2i(glGetUniformLocation(fieldProgram, "wrap"), g.wrap.x, g.wrap.y);
+        glUniform2fv(glGetUniformLocation(fieldProgram, "lattice_shift"), 1, value_ptr(shift));
+        glUniform1i(glGetUniformLocation(fieldProgram, "mesh_res"), g.mesh_res());
+        glUniform1i(glGetUniformLocation(fieldProgram, "mesh_stride"), g.stride);
+        glUniform2i(glGetUniformLocation(fieldProgram, "mesh_first"), g.align(g.origin.x) - g.origin.x, g.align(g.origin.y) - g.origin.y);
+        glUniform1i(glGetUniformLocation(fieldProgram, "field_res"), g.field_res);
+        glUniform1f(glGetUniformLocation(fieldProgram, "zoomx"), zoomx);
+        glUniform1f(glGetUniformLocation(fieldProgram, "zoomy"), zoomy);
+        glUniform1f(glGetUniformLocation(fieldProgram, "zoomz"), zoomz);
+        glUniform1f(glGetUniformLocation(fieldProgram, "graph_size"), graph_size);
+        glUniform3fv(glGetUniformLocation(fieldProgram, "centerPos"), 1, value_ptr(centerPos));
+        glUniform4fv(glGetUniformLocation(fieldProgram, "color"), 1, value_ptr(g.color));
+        glUniform4fv(glGetUniformLocation(fieldProgram, "secondary_color"), 1, value_ptr(g.secondary_color));
+        glDispatchCompute((g.field_res + 7) / 8, (g.field_res + 7) / 8, 1);
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        glUseProgram(shaderProgram);
+    }
+
+    // an expression of the integral tools as the statements of a GLSL
+    // function returning it, parsed like a definition; false with the parse
+    // error in infoLog
+    bool tool_glsl(const char* source, const SymbolTable& symbols, std::string& body, char* infoLog) const {
+        Expression expr;
+        std::string error;
+        if (!expr.parse(source, symbols, error)) {
+            snprintf(infoLog, 512, "%s: %s", source, error.c_str());
+            return false;
+        }
+        body = expr.glsl();
+        return true;
+    }
+
+    std::pair<float, float> min_max(const char* var, const char* func, float rbegin, float rend, int samplesize, char* infoLog) {
         const char* computeSource = R"glsl(
 #version 460 core
 
@@ -1160,6 +2242,9 @@ layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
 layout(std430, binding = 4) volatile buffer sbuf1 {
 	float samples[];
 };
+layout(std430, binding = 3) readonly buffer sliderbuffer {
+	float sliders[];
+};
 uniform int samplesize;
 uniform float rbegin;
 uniform float rend;
@@ -1174,35 +2259,28 @@ float csc(float x) {
 	return 1.f / sin(x);
 }
 
+float bound(float %s) {
+	%s
+}
+
 void main() {
-	float %c = rbegin + ((rend - rbegin) / samplesize) * float(gl_GlobalInvocationID.x);
-    samples[gl_GlobalInvocationID.x] = float(%s);
+    samples[gl_GlobalInvocationID.x] = bound(rbegin + ((rend - rbegin) / samplesize) * float(gl_GlobalInvocationID.x));
 })glsl";
-        size_t size = strlen(computeSource) + strlen(func) + 1;
+        SymbolTable symbols = expression_symbols(sliders);
+        symbols.add_variable(var);
+        std::string body;
+        if (!tool_glsl(func, symbols, body, infoLog)) return std::pair(std::numeric_limits<float>::quiet_NaN(), 0.f);
+        size_t size = strlen(computeSource) + strlen(var) + body.size() + 1;
         char* modifiedSource = new char[size];
-        snprintf(modifiedSource, size, computeSource, var, func);
-        glShaderSource(computeShader, 1, &modifiedSource, NULL);
-        glCompileShader(computeShader);
-        int success;
-        glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char temp[512];
-            glGetShaderInfoLog(computeShader, 512, NULL, temp);
-            int k = 0;
-            for (int i = 0, j = 0; i < strlen(temp); i++, j++) {
-                if (j < 21) continue;
-                infoLog[k++] = temp[i];
-                if (temp[i] == '\n') j = -1;
-            }
-            infoLog[k] = '\0';
+        snprintf(modifiedSource, size, computeSource, var, body.c_str());
+        std::string log;
+        GLuint computeProgram = program_cache.acquire({ { GL_COMPUTE_SHADER, modifiedSource } }, log);
+        delete[] modifiedSource;
+        if (computeProgram == 0) {
+            strip_log(log, infoLog);
             return std::pair(std::numeric_limits<float>::quiet_NaN(), 0.f);
         }
-        GLuint computeProgram = glCreateProgram();
-        glAttachShader(computeProgram, computeShader);
-        glLinkProgram(computeProgram);
-        glDeleteShader(computeShader);
         glUseProgram(computeProgram);
-        delete[] modifiedSource;
 
         GLuint sampleBuffer;
         glGenBuffers(1, &sampleBuffer);
@@ -1228,7 +2306,7 @@ void main() {
             if (s > max) max = s;
         }
         delete[] data;
-        glDeleteProgram(computeProgram);
+        program_cache.release(computeProgram);
         glDeleteBuffers(1, &sampleBuffer);
         return std::pair(min, max);
     }
@@ -1241,8 +2319,8 @@ void main() {
             break;
         case Type1: {
             xmin = x_min, xmax = x_max;
-            std::pair<float, float> yminbounds = min_max('x', y_min_eq, xmin, xmax, g.grid_res, infoLog);
-            std::pair<float, float> ymaxbounds = min_max('x', y_max_eq, xmin, xmax, g.grid_res, infoLog);
+            std::pair<float, float> yminbounds = min_max("x", y_min_eq, xmin, xmax, g.grid_res, infoLog);
+            std::pair<float, float> ymaxbounds = min_max("x", y_max_eq, xmin, xmax, g.grid_res, infoLog);
             if (isnan(yminbounds.first)) return 0;
             if (isnan(ymaxbounds.first)) return 1;
             ymin = y_min_eq_min = yminbounds.first, ymax = y_max_eq_max = ymaxbounds.second;
@@ -1251,8 +2329,8 @@ void main() {
         }
         case Type2: {
             ymin = y_min, ymax = y_max;
-            std::pair<float, float> xminbounds = min_max('y', x_min_eq, ymin, ymax, g.grid_res, infoLog);
-            std::pair<float, float> xmaxbounds = min_max('y', x_max_eq, ymin, ymax, g.grid_res, infoLog);
+            std::pair<float, float> xminbounds = min_max("y", x_min_eq, ymin, ymax, g.grid_res, infoLog);
+            std::pair<float, float> xmaxbounds = min_max("y", x_max_eq, ymin, ymax, g.grid_res, infoLog);
             if (isnan(xminbounds.first)) return 0;
             if (isnan(xmaxbounds.first)) return 1;
             xmin = x_min_eq_min = xminbounds.first, xmax = x_max_eq_max = xmaxbounds.second;
@@ -1260,8 +2338,8 @@ void main() {
             break;
         }
         case Polar: {
-            std::pair<float, float> rminbounds = min_max('t', r_min_eq, theta_min, theta_max, g.grid_res, infoLog);
-            std::pair<float, float> rmaxbounds = min_max('t', r_max_eq, theta_min, theta_max, g.grid_res, infoLog);
+            std::pair<float, float> rminbounds = min_max("t", r_min_eq, theta_min, theta_max, g.grid_res, infoLog);
+            std::pair<float, float> rmaxbounds = min_max("t", r_max_eq, theta_min, theta_max, g.grid_res, infoLog);
             if (isnan(rminbounds.first)) return 0;
             if (isnan(rmaxbounds.first)) return 1;
             xmax = ymax = rmaxbounds.second;
@@ -1271,85 +2349,218 @@ void main() {
         return -1;
     }
 
+    // evaluates rows [first_row, first_row + rows) of workgroups of the job's integrand in reduce
+    // mode and sums their finite, in-region values on the GPU; returns the
+    // index of the reduce buffer holding the resulting double
+    int reduce_band(const IntegralJob& job, int first_row, int rows) {
+        const Graph& g = job.g;
+        GLuint groups = (g.grid_res + tile_size - 1) / tile_size;
+        GLuint count = groups * rows;
+
+        // the program may be shared with a rendered graph, so every uniform is set again
+        glUseProgram(g.computeProgram);
+        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomx"), job.size.x);
+        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomy"), job.size.y);
+        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomz"), 1.f);
+        glUniform1i(glGetUniformLocation(g.computeProgram, "grid_res"), g.grid_res);
+        glUniform3fv(glGetUniformLocation(g.computeProgram, "centerPos"), 1, value_ptr(job.center));
+        glUniform1i(glGetUniformLocation(g.computeProgram, "reduce"), true);
+        glUniform1i(glGetUniformLocation(g.computeProgram, "group_offset"), first_row);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, reduceBuffers[0]);
+        glDispatchCompute(groups, rows, 1);
+
+        glUseProgram(reduceProgram);
+        int src = 0;
+        while (count > 1) {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, reduceBuffers[src]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, reduceBuffers[src ^ 1]);
+            glUniform1ui(glGetUniformLocation(reduceProgram, "count"), count);
+            count = (count + 511) / 512;
+            glDispatchCompute(count, 1, 1);
+            src ^= 1;
+        }
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glUseProgram(shaderProgram);
+        return src;
+    }
+
+    // meshes g's evaluated grid with a restricted quadtree, the node errors
+    // are computed a level per dispatch from the finest up and read back once
+    // their fence has signalled, by a later call; g.mesh_dirty stays set and
+    // the uniform strip is drawn until then. Errors of a grid evaluated again
+    // in the meantime are dropped and requested anew
+    void build_mesh(Graph& g) {
+        Quadtree tree(g.eval_res);
+        if (g.errorFence) {
+            if (glClientWaitSync(g.errorFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return;
+            glDeleteSync(g.errorFence);
+            g.errorFence = nullptr;
+            if (g.error_stamp == g.stamp && g.error_origin == g.origin) {
+                std::vector<float> errors(tree.error_count);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.errorBuffer);
+                glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, errors.size() * sizeof(float), errors.data());
+
+                std::vector<uint32_t> indices;
+                tree.build(errors, mesh_tolerance / g.eval_res, indices);
+                if (g.EBO == 0) glGenBuffers(1, &g.EBO);
+                glBindVertexArray(graphVAO);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g.EBO);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_DYNAMIC_DRAW);
+                glBindVertexArray(VAO);
+                g.mesh_indices = indices.size();
+                g.mesh_dirty = false;
+                return;
+            }
+        }
+
+        if (g.errorBuffer == 0) glGenBuffers(1, &g.errorBuffer);
+        glUseProgram(quadtreeProgram);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, g.errorBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tree.error_count * sizeof(float), nullptr, GL_DYNAMIC_READ);
+        glUniform1i(glGetUniformLocation(quadtreeProgram, "grid_res"), g.eval_res);
+        glUniform2i(glGetUniformLocation(quadtreeProgram, "wrap"), g.wrap.x, g.wrap.y);
+        for (int l = 1; l <= tree.levels; l++) {
+            glUniform1i(glGetUniformLocation(quadtreeProgram, "level"), l);
+            glUniform1i(glGetUniformLocation(quadtreeProgram, "level_res"), tree.res[l]);
+            glUniform1i(glGetUniformLocation(quadtreeProgram, "level_offset"), tree.offset[l]);
+            glUniform1i(glGetUniformLocation(quadtreeProgram, "child_res"), tree.res[l - 1]);
+            glUniform1i(glGetUniformLocation(quadtreeProgram, "child_offset"), tree.offset[l - 1]);
+            glDispatchCompute((tree.res[l] + 15) / 16, (tree.res[l] + 15) / 16, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        g.errorFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        g.error_stamp = g.stamp;
+        g.error_origin = g.origin;
+        glUseProgram(shaderProgram);
+    }
+
+    void start_integral_job(Graph& g, vec2 size, vec3 center) {
+        cancel_integral_job();
+        if (cpu_evaluation && g.cpu_ready) {
+            // summed right away, the CPU backend has no frame to keep responsive
+            std::vector<float> values(sliders.size());
+            for (int i = 0; i < values.size(); i++) values[i] = sliders[i].value;
+            integral_result = g.cpu.sum({ g.grid_res, size.x, size.y, 1.f, center.x, center.y }, values, g.plane_params) * dx * dy;
+            if (g.computeProgram != 0) program_cache.release(g.computeProgram);
+            return;
+        }
+        if (g.computeProgram == 0) return;
+        IntegralJob& job = integral_job;
+        job.g = g;
+        job.size = size;
+        job.center = center;
+        job.group_rows = (g.grid_res + tile_size - 1) / tile_size;
+        job.rows_per_band = std::max(1, integral_band_points / (g.grid_res * tile_size));
+        job.next_row = job.summed_rows = 0;
+        job.sum = job.compensation = 0.0;
+        job.active = true;
+        integral_result = 0.0;
+
+        GLuint count = job.group_rows * std::min(job.rows_per_band, job.group_rows);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, reduceBuffers[0]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(double), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, reduceBuffers[1]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (count + 511) / 512 * sizeof(double), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    void cancel_integral_job() {
+        IntegralJob& job = integral_job;
+        if (!job.active) return;
+        if (job.fence) glDeleteSync(job.fence);
+        job.fence = nullptr;
+        program_cache.release(job.g.computeProgram);
+        job.active = false;
+    }
+
+    // advances the running integral by at most one band per frame; a band's
+    // sum is read back only once its fence has signalled, so the render loop
+    // never waits on the GPU
+    void step_integral_job() {
+        IntegralJob& job = integral_job;
+        if (!job.active) return;
+        if (!show_integral_result) {
+            cancel_integral_job();
+            return;
+        }
+        if (job.fence) {
+            if (glClientWaitSync(job.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return;
+            glDeleteSync(job.fence);
+            job.fence = nullptr;
+            double band = 0.0;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, reduceBuffers[job.result_buffer]);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(double), &band);
+            // Kahan summation over the band sums
+            double y = band - job.compensation;
+            double t = job.sum + y;
+            job.compensation = (t - job.sum) - y;
+            job.sum = t;
+            job.summed_rows = job.next_row;
+            integral_result = job.sum * dx * dy;
+        }
+        if (job.next_row >= job.group_rows) {
+            program_cache.release(job.g.computeProgram);
+            job.active = false;
+            return;
+        }
+        int rows = std::min(job.rows_per_band, job.group_rows - job.next_row);
+        job.result_buffer = reduce_band(job, job.next_row, rows);
+        job.next_row += rows;
+        job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
     int compute_doubleintegral(char* infoLog) {
         Graph g = graphs[integrand_index];
         g.grid_res = integral_precision;
+        g.computeProgram = 0; // compiled separately below, owned by the integral job
+        g.compiling = false;
         float xmin{}, xmax{}, ymin{}, ymax{};
         char regionBool[256];
 
-        if (int err = compute_boundary(g, regionBool, xmin, xmax, ymin, ymax, infoLog) != -1) return err;
-        g.upload_definition(sliders, regionBool, "z", region_type == Polar);
+        if (int err = compute_boundary(g, regionBool, xmin, xmax, ymin, ymax, infoLog); err != -1) return err;
+        g.upload_definition(sliders, regionBool, "z");
+        if (g.computeProgram == 0) {
+            snprintf(infoLog, 512, "%s", g.infoLog);
+            return 0;
+        }
 
         center_of_region = vec3((xmax + xmin) / 2.f, (ymax + ymin) / 2.f, 0.f);
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomx"), abs(xmax - xmin));
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomy"), abs(ymax - ymin));
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomz"), 1.f);
-        glUniform1i(glGetUniformLocation(g.computeProgram, "grid_res"), g.grid_res);
-        glUniform3fv(glGetUniformLocation(g.computeProgram, "centerPos"), 1, value_ptr(center_of_region));
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.SSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 2ull * g.grid_res * g.grid_res * (int)sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glDispatchCompute(g.grid_res, g.grid_res, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        float* data = new float[2ull * g.grid_res * g.grid_res] {};
-        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, 2ull * g.grid_res * g.grid_res * sizeof(float), data);
         dx = abs(xmax - xmin) / g.grid_res;
         dy = abs(ymax - ymin) / g.grid_res;
-        integral_result = 0.f;
-        for (int i = 0; i < 2 * g.grid_res * g.grid_res; i += 2) {
-            float x = (graph_size / g.grid_res) * (fmod(i / 2.f, g.grid_res) - g.grid_res / 2.f);
-            float y = (graph_size / g.grid_res) * ((g.grid_res - floor((i / 2.f) / g.grid_res)) - g.grid_res / 2.f);
-            float val = data[i];
-            bool in_region = static_cast<bool>(data[i + 1]);
-            if (isnan(val) || isinf(val) || !in_region) continue;
-            integral_result += val * dx * dy;
-        }
-        delete[] data;
-        graphs[integrand_index].upload_definition(sliders, regionBool, "z", region_type == Polar);
+        start_integral_job(g, vec2(abs(xmax - xmin), abs(ymax - ymin)), center_of_region);
+        graphs[integrand_index].upload_definition(sliders, regionBool, "z");
         return -1;
     }
 
     int compute_surfaceintegral(char* infoLog) {
         Graph g = graphs[integrand_index];
         g.grid_res = integral_precision;
+        g.computeProgram = 0; // compiled separately below, owned by the integral job
+        g.compiling = false;
         float xmin{}, xmax{}, ymin{}, ymax{};
         char regionBool[256];
 
-        compute_boundary(g, regionBool, xmin, xmax, ymin, ymax, infoLog);
+        if (int err = compute_boundary(g, regionBool, xmin, xmax, ymin, ymax, infoLog); err != -1) return err;
         char scalarField[128];
         snprintf(scalarField, 128, "(%s) * sqrt(px * px + py * py + 1)", scalar_field_eq);
-        g.upload_definition(sliders, regionBool, scalarField, region_type == Polar, true);
+        g.upload_definition(sliders, regionBool, scalarField);
+        if (g.computeProgram == 0) {
+            snprintf(infoLog, 512, "%s", g.infoLog);
+            return 0;
+        }
 
         center_of_region = vec3((xmax + xmin) / 2.f, (ymax + ymin) / 2.f, 0.f);
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomx"), abs(xmax - xmin));
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomy"), abs(ymax - ymin));
-        glUniform1f(glGetUniformLocation(g.computeProgram, "zoomz"), 1.f);
-        glUniform1i(glGetUniformLocation(g.computeProgram, "grid_res"), g.grid_res);
-        glUniform3fv(glGetUniformLocation(g.computeProgram, "centerPos"), 1, value_ptr(center_of_region));
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.SSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 2ull * g.grid_res * g.grid_res * (int)sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glDispatchCompute(g.grid_res, g.grid_res, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        float* data = new float[2ull * g.grid_res * g.grid_res] {};
-        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, 2ull * g.grid_res * g.grid_res * sizeof(float), data);
         dx = abs(xmax - xmin) / g.grid_res;
         dy = abs(ymax - ymin) / g.grid_res;
-        integral_result = 0.f;
-        for (int i = 0; i < 2 * g.grid_res * g.grid_res; i += 2) {
-            float x = (graph_size / g.grid_res) * (fmod(i / 2.f, g.grid_res) - g.grid_res / 2.f);
-            float y = (graph_size / g.grid_res) * ((g.grid_res - floor((i / 2.f) / g.grid_res)) - g.grid_res / 2.f);
-            float val = data[i];
-            bool in_region = static_cast<bool>(data[i + 1]);
-            if (isnan(val) || isinf(val) || !in_region) continue;
-            integral_result += val * dx * dy;
-        }
-        delete[] data;
-        graphs[integrand_index].upload_definition(sliders, regionBool, "z", region_type == Polar);
+        start_integral_job(g, vec2(abs(xmax - xmin), abs(ymax - ymin)), center_of_region);
+        graphs[integrand_index].upload_definition(sliders, regionBool, "z");
         return -1;
     }
 
     int compute_lineintegral(char* infoLog) {
         Graph g = graphs[integrand_index];
-        unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
         const char* computeSource = R"glsl(
 #version 460 core
 
@@ -1358,9 +2569,13 @@ layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
 layout(std430, binding = 6) volatile buffer sbuf3 {
 	float samples[];
 };
+layout(std430, binding = 3) readonly buffer sliderbuffer {
+	float sliders[];
+};
 uniform int samplesize;
 uniform float tbegin;
 uniform float tend;
+uniform float plane_params[5];
 
 float cot(float x) {
 	return 1.f / tan(x);
@@ -1372,6 +2587,16 @@ float csc(float x) {
 	return 1.f / sin(x);
 }
 
+float path_x(float t) {
+	%s
+}
+float path_y(float t) {
+	%s
+}
+float f(float x, float y) {
+	%s
+}
+
 float to_trange(float t) {
     return tbegin + t / samplesize * (tend - tbegin);
 }
@@ -1381,60 +2606,53 @@ void main() {
     float t = to_trange(float(gl_GlobalInvocationID.x));
     float dt = next_t - t;
 
-    float x = (%s);
-    float y = (%s);
-    t = next_t;
-    float dx = ((%s) - x);
-    float dy = ((%s) - y);
+    float x = path_x(t);
+    float y = path_y(t);
+    float dx = path_x(next_t) - x;
+    float dy = path_y(next_t) - y;
 
-    samples[gl_GlobalInvocationID.x * 4] = float(%s);
+    samples[gl_GlobalInvocationID.x * 4] = f(x, y);
     samples[gl_GlobalInvocationID.x * 4 + 1] = length(vec2(dx / dt, dy / dt));
     samples[gl_GlobalInvocationID.x * 4 + 2] = x;
     samples[gl_GlobalInvocationID.x * 4 + 3] = y;
 })glsl";
-        size_t size = strlen(computeSource) + sizeof(x_param_eq) * 4 + sizeof(Graph::defn);
+        // the path is in t, the integrand in x and y as its graph is defined
+        SymbolTable path = expression_symbols(sliders);
+        path.add_variable("t");
+        SymbolTable field = expression_symbols(sliders);
+        field.add_variable("x");
+        field.add_variable("y");
+        field.add_macro("t", "atan(-y, -x) + PI");
+        field.add_array("plane_params", 5);
+        std::string path_x, path_y, f;
+        if (!tool_glsl(x_param_eq, path, path_x, infoLog) || !tool_glsl(y_param_eq, path, path_y, infoLog) || !tool_glsl(g.defn, field, f, infoLog))
+            return 1;
+        size_t size = strlen(computeSource) + path_x.size() + path_y.size() + f.size() + 1;
         char* modifiedSource = new char[size];
-        snprintf(modifiedSource, size, computeSource, x_param_eq, y_param_eq, x_param_eq, y_param_eq, g.defn);
-        glShaderSource(computeShader, 1, &modifiedSource, NULL);
-        glCompileShader(computeShader);
-        int success;
-        glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char temp[512];
-            glGetShaderInfoLog(computeShader, 512, NULL, temp);
-            int k = 0;
-            for (int i = 0, j = 0; i < strlen(temp); i++, j++) {
-                if (j < 21) continue;
-                infoLog[k++] = temp[i];
-                if (temp[i] == '\n') j = -1;
-            }
-            infoLog[k] = '\0';
+        snprintf(modifiedSource, size, computeSource, path_x.c_str(), path_y.c_str(), f.c_str());
+        std::string log;
+        GLuint computeProgram = program_cache.acquire({ { GL_COMPUTE_SHADER, modifiedSource } }, log);
+        delete[] modifiedSource;
+        if (computeProgram == 0) {
+            strip_log(log, infoLog);
             return 1;
         }
-        GLuint computeProgram = glCreateProgram();
-        glAttachShader(computeProgram, computeShader);
-        glLinkProgram(computeProgram);
-        glDeleteShader(computeShader);
         glUseProgram(computeProgram);
-        delete[] modifiedSource;
 
-        GLuint sampleBuffer;
-        glGenBuffers(1, &sampleBuffer);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, sampleBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, sampleBuffer);
+        // kept for draw_lineintegral, which reads the path and values from it
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lineSamples);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, lineSamples);
         glShaderStorageBlockBinding(computeProgram, glGetProgramResourceIndex(computeProgram, GL_SHADER_STORAGE_BLOCK, "sbuf3"), 6);
         glBufferData(GL_SHADER_STORAGE_BUFFER, integral_precision * 4ull * sizeof(float), nullptr, GL_STATIC_DRAW);
 
         glUniform1i(glGetUniformLocation(computeProgram, "samplesize"), integral_precision);
         glUniform1f(glGetUniformLocation(computeProgram, "tbegin"), t_min);
         glUniform1f(glGetUniformLocation(computeProgram, "tend"), t_max);
+        glUniform1fv(glGetUniformLocation(computeProgram, "plane_params"), 5, g.plane_params);
 
         glDispatchCompute(integral_precision, 1, 1);
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-        if (li_data) delete[] li_data;
-        li_data = new float[integral_precision * 3];
-        li_data_ws = new float[integral_precision * 6];
         li_samplecount = integral_precision;
 
         float* data = new float[integral_precision * 4];
@@ -1446,23 +2664,14 @@ void main() {
         auto get_data = [&](int i) {
             return vec4(data[i * 4 + 2], data[i * 4 + 3], data[i * 4], data[i * 4 + 1]);
         };
-        auto add_vertex = [&](int i) {
-            vec3 cv = get_data(i);
-
-            li_data[i * 3 + 0] = cv.x;
-            li_data[i * 3 + 1] = cv.y;
-            li_data[i * 3 + 2] = cv.z;
-        };
 
         for (int i = 0; i < integral_precision; i++) {
             vec4 d = get_data(i);
             integral_result += d.z * d.w * dt;
             center_of_region += vec3(d) / static_cast<float>(integral_precision);
-            add_vertex(i);
         }
         delete[] data;
-        glDeleteProgram(computeProgram);
-        glDeleteBuffers(1, &sampleBuffer);
+        program_cache.release(computeProgram);
         return 0;
     }
 
@@ -1567,15 +2776,14 @@ public:
 
         GLuint integral_texture = dintegral_texture;
 
-        GLuint srcFBO, dstFBO;
-        glGenFramebuffers(1, &srcFBO);
-        glGenFramebuffers(1, &dstFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, srcFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, dstFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, prevZBuffer, 0);
-        
+        bool animating = true;
         do {
+            // a blinking text cursor is the only thing that changes without an event
+            if (redraw_on_demand && !animating && redraw_frames == 0 && !picks_pending())
+                glfwWaitEventsTimeout(ImGui::GetIO().WantTextInput ? 0.5 : 10.0);
+            else if (redraw_frames > 0)
+                redraw_frames--;
+
             ImGui_ImplOpenGL3_NewFrame();
             ImGui_ImplGlfw_NewFrame();
             glfwPollEvents();
@@ -1620,19 +2828,13 @@ public:
             }
             glUniform3fv(glGetUniformLocation(shaderProgram, "centerPos"), 1, value_ptr(centerPos));
 
+            // graphs changed during interaction are previewed coarsely, and
+            // refined once input has been quiet for a moment
+            if (zoomSpeed != 1.f || cameraVelocity != vec2(0.f) || centerPos != next_centerPos)
+                interactionTimestamp = currentTime;
+
             frameCount++;
-            fps_history[frameCount % 5] = 1.0 / timeStep;
-            if (frameCount >= 20) {
-                double avg = 0.;
-                for (int i = 0; i < 5; i++)
-                    avg += fps_history[i] / 5;
-                if (avg < 20 && ssaa && !ssaa_enabled_by_user) {
-                    ssaa = false;
-                    ssaa_factor = 1.f;
-                    on_windowResize(window, wWidth, wHeight);
-                    glUniform1i(glGetUniformLocation(shaderProgram, "radius"), ssaa_factor);
-                }
-            }
+            update_quality(currentTime);
 
             ImGui::PushFont(font_title);
 
@@ -1683,18 +2885,28 @@ public:
                         glUniform1i(glGetUniformLocation(shaderProgram, "coloring"), coloring);
                     }
                     ImGui::Separator();
-                    if (ImGui::MenuItem("Anti-aliasing", nullptr, &ssaa)) {
-                        if (ssaa) {
-                            ssaa_factor = 3.f;
-                            ssaa_enabled_by_user = true;
+                    if (ImGui::BeginMenu("Anti-aliasing")) {
+                        const char* modes[]{ "None", "SSAA", "MSAA", "FXAA", "TAA" };
+                        for (int mode = NoAA; mode <= TAA; mode++) {
+                            if (ImGui::MenuItem(modes[mode], nullptr, aa_mode == mode) && aa_mode != mode) {
+                                aa_mode = mode;
+                                on_windowResize(window, wWidth, wHeight);
+                                // leaving SSAA drops any supersampling right away
+                                update_quality(currentTime);
+                            }
                         }
-                        else ssaa_factor = 1.f;
-                        on_windowResize(window, wWidth, wHeight);
-                        glUniform1i(glGetUniformLocation(shaderProgram, "radius"), ssaa_factor);
+                        ImGui::EndMenu();
                     }
+                    ImGui::MenuItem("Dynamic resolution", nullptr, &dynamic_resolution);
+                    ImGui::MenuItem("Redraw on demand", nullptr, &redraw_on_demand);
+                    ImGui::BeginDisabled(!dynamic_resolution);
+                    ImGui::SetNextItemWidth(100.f);
+                    ImGui::SliderFloat("Target frame time", &target_frame_ms, 4.f, 50.f, "%.1f ms");
+                    ImGui::EndDisabled();
                     if (ImGui::MenuItem("Shading", nullptr, &shading)) {
                         glUniform1i(glGetUniformLocation(shaderProgram, "shading"), shading);
                     }
+                    ImGui::MenuItem("Evaluate on CPU", nullptr, &cpu_evaluation);
                     ImGui::EndMenu();
                 }
                 if (ImGui::BeginMenu("Help")) {
@@ -1762,15 +2974,11 @@ public:
             ImGui::Begin("Symbolic View", nullptr, ImGuiWindowFlags_NoNavInputs | ImGuiWindowFlags_NoMove);
 
             float sw = ImGui::GetWindowSize().x;
-            if (sw != sidebarWidth) {
-                sidebarWidth = sw;
-                updateBufferSize = true;
-            }
+            if (sw != sidebarWidth) sidebarWidth = sw;
             bool set_focus = false;
             if (ImGui::Button("New function", ImVec2(100, 0))) {
                 size_t i = graphs.size() - 1;
-                graphs.push_back(Graph(graphs.size(), UserDefined, "", 500, colors[i % colors.size()], colors[(i + 1) % colors.size()], false, gridSSBO, EBO));
-                graphs[graphs.size() - 1].setup();
+                graphs.push_back(Graph(graphs.size(), UserDefined, "", 500, colors[i % colors.size()], colors[(i + 1) % colors.size()], false));
                 for (Slider& s : sliders) {
                     s.used_in.push_back(false);
                 }
@@ -1821,12 +3029,11 @@ public:
                     ImGui::SetKeyboardFocusHere(0);
                 }
                 if (ImGui::InputText(std::format("##defn{}", i).c_str(), g.defn, 256)) {
-                    g.upload_definition(sliders);
+                    g.request_definition(sliders);
                     if (g.valid) g.enabled = true;
                     if (i == integrand_index) {
                         glUniform1i(glGetUniformLocation(shaderProgram, "integral"), false);
                         integral = show_integral_result = apply_integral = second_corner = false;
-                        if (integrand_index != -1) graphs[integrand_index].upload_definition(sliders);
                     }
                 }
                 ImGui::SameLine();
@@ -1861,10 +3068,14 @@ public:
                         glUniform1i(glGetUniformLocation(shaderProgram, "integral"), false);
                         tangent_plane = false;
                     }
+                    g.release();
                     graphs.erase(graphs.begin() + i);
                     for (Slider& s : sliders) {
                         s.used_in.erase(s.used_in.begin() + i);
                     }
+                    for (size_t j = i; j < graphs.size(); j++) {
+                        graphs[j].idx = j;
+                    }
                     ImGui::EndChild();
                     continue;
                 }
@@ -1878,14 +3089,50 @@ public:
                 if (g.advanced_view) {
                     ImGui::BeginDisabled(!g.valid);
                     ImGui::SetNextItemWidth(40.f);
-                    if (ImGui::DragInt(std::format("Resolution##{}", i).c_str(), &g.grid_res, g.grid_res / 20.f, 10, 1000)) {
-                        g.setup();
-                    }
+                    if (g.form == Implicit)
+                        ImGui::DragInt(std::format("Resolution##{}", i).c_str(), &g.volume_res, g.volume_res / 20.f, 16, 256);
+                    else
+                        ImGui::DragInt(std::format("Resolution##{}", i).c_str(), &g.grid_res, g.grid_res / 20.f, 10, 1000);
                     ImGui::SetNextItemWidth(40.f);
                     ImGui::SameLine();
                     ImGui::DragFloat(std::format("Shininess##{}", i).c_str(), &g.shininess, g.shininess / 40.f, 1.f, 1024.f, "%.0f");
                     ImGui::SameLine();
                     ImGui::Checkbox(std::format("Grid##{}", i).c_str(), &g.grid_lines);
+                    if (g.form == Parametric) {
+                        ImGui::SetNextItemWidth(100.f);
+                        ImGui::DragFloat2(std::format("u##range{}", i).c_str(), value_ptr(g.u_range), 0.01f);
+                        ImGui::SameLine();
+                        ImGui::SetNextItemWidth(100.f);
+                        ImGui::DragFloat2(std::format("v##range{}", i).c_str(), value_ptr(g.v_range), 0.01f);
+                    }
+                    // all are over the lattice of an explicit graph
+                    ImGui::BeginDisabled(g.form != Explicit);
+                    ImGui::Checkbox(std::format("Adaptive mesh##{}", i).c_str(), &g.adaptive);
+                    if (g.adaptive && g.mesh_indices > 0 && g.form == Explicit) {
+                        size_t triangles = g.mesh_indices / 3;
+                        Quadtree tree(g.eval_res);
+                        ImGui::SameLine();
+                        ImGui::Text("%zu triangles, %.1f%% of uniform", triangles, 100.0 * triangles / tree.uniform_triangles());
+                    }
+                    ImGui::Checkbox(std::format("Gradient field##{}", i).c_str(), &g.vector_field);
+                    ImGui::BeginDisabled(!g.vector_field);
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(40.f);
+                    ImGui::DragInt(std::format("Arrows##{}", i).c_str(), &g.field_res, 0.5f, 2, 100);
+                    ImGui::EndDisabled();
+                    ImGui::Checkbox(std::format("Contours##{}", i).c_str(), &g.contours);
+                    ImGui::BeginDisabled(!g.contours);
+                    ImGui::SameLine();
+                    ImGui::Checkbox(std::format("On floor##{}", i).c_str(), &g.contour_floor);
+                    ImGui::SameLine();
+                    ImGui::BeginDisabled(g.contour_list[0] != '\0');
+                    ImGui::SetNextItemWidth(40.f);
+                    ImGui::DragInt(std::format("Levels##{}", i).c_str(), &g.contour_count, 0.2f, 1, max_contour_levels);
+                    ImGui::EndDisabled();
+                    ImGui::SetNextItemWidth(160.f);
+                    ImGui::InputTextWithHint(std::format("z levels##{}", i).c_str(), "evenly spaced", g.contour_list, sizeof(g.contour_list));
+                    ImGui::EndDisabled();
+                    ImGui::EndDisabled();
                     ImGui::EndDisabled();
                 }
                 ImGui::EndChild();
@@ -2175,6 +3422,9 @@ public:
                     vMax = ImGui::GetWindowContentRegionMax() + ImGui::GetWindowPos();
 
                     const char* preview = graphs[integrand_index].defn;
+                    // only explicit graphs are generated with a region and a scalar
+                    // field, those of other forms are left to be replaced in the combo
+                    bool integrable = graphs[integrand_index].form == Explicit;
                     auto to_imcol32 = [](const glm::vec4& color) {
                         ImU8 r = static_cast<ImU8>(clamp(color.r, 0.f, 1.f) * 255.f);
                         ImU8 g = static_cast<ImU8>(clamp(color.g, 0.f, 1.f) * 255.f);
@@ -2202,6 +3452,7 @@ public:
                             vMax = ImGui::GetWindowContentRegionMax() + ImGui::GetWindowPos();
                             ImGui::PushItemWidth((vMax.x - vMin.x - 42.f) / 2.f);
                             bool ready = true;
+                            ImGui::BeginDisabled(!integrable);
                             switch (region_type) {
                             case CartesianRectangle:
                                 ImGui::InputFloat(U8(u8"\u2264 x \u2264"), &x_min, 0.f, 0.f, "%g");
@@ -2256,11 +3507,12 @@ public:
                                 break;
                             }
                             ImGui::PopItemWidth();
+                            ImGui::EndDisabled();
                             ImGui::SetNextItemWidth(vMax.x - vMin.x - 81.f);
 
                             if (ImGui::BeginCombo("##integrand", preview)) {
                                 for (int n = 1; n < graphs.size(); n++) {
-                                    if (!graphs[n].enabled) continue;
+                                    if (!graphs[n].enabled || graphs[n].form != Explicit) continue;
                                     const bool is_selected = (integrand_index == n);
                                     ImGui::PushStyleColor(ImGuiCol_Text, to_imcol32(graphs[n].color * 1.1f));
                                     if (ImGui::Selectable(graphs[n].defn, is_selected))
@@ -2281,7 +3533,7 @@ public:
                                 ImGui::SetTooltip("Precision, higher the better", ImGui::GetStyle().HoverDelayNormal);
 
                             ImGui::EndDisabled();
-                            ImGui::BeginDisabled(!ready || show_integral_result || second_corner);
+                            ImGui::BeginDisabled(!ready || !integrable || show_integral_result || second_corner);
                             if (ImGui::Button("Compute", ImVec2(vMax.x - vMin.x, 0.f))) {
                                 last_integration_type = DoubleIntegral;
                                 glUniform1i(glGetUniformLocation(shaderProgram, "integral"), DoubleIntegral);
@@ -2315,6 +3567,7 @@ public:
                             vMax = ImGui::GetWindowContentRegionMax() + ImGui::GetWindowPos();
                             ImGui::PushItemWidth((vMax.x - vMin.x - 42.f) / 2.f);
                             bool ready = true;
+                            ImGui::BeginDisabled(!integrable);
                             switch (region_type) {
                             case CartesianRectangle:
                                 ImGui::InputFloat(U8(u8"\u2264 x \u2264"), &x_min, 0.f, 0.f, "%g");
@@ -2375,11 +3628,12 @@ public:
                             if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal | ImGuiHoveredFlags_NoSharedDelay))
                                 ImGui::SetTooltip("Enter a function of x, y and z", ImGui::GetStyle().HoverDelayNormal);
                             if (strlen(scalar_field_eq) == 0) ready = false;
+                            ImGui::EndDisabled();
 
                             ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - 81.f);
                             if (ImGui::BeginCombo("##integrand", preview)) {
                                 for (int n = 1; n < graphs.size(); n++) {
-                                    if (!graphs[n].enabled) continue;
+                                    if (!graphs[n].enabled || graphs[n].form != Explicit) continue;
                                     const bool is_selected = (integrand_index == n);
                                     ImGui::PushStyleColor(ImGuiCol_Text, to_imcol32(graphs[n].color * 1.1f));
                                     if (ImGui::Selectable(graphs[n].defn, is_selected))
@@ -2400,7 +3654,7 @@ public:
                                 ImGui::SetTooltip("Precision, higher the better", ImGui::GetStyle().HoverDelayNormal);
 
                             ImGui::EndDisabled();
-                            ImGui::BeginDisabled(!ready || show_integral_result || second_corner);
+                            ImGui::BeginDisabled(!ready || !integrable || show_integral_result || second_corner);
                             if (ImGui::Button("Compute", ImVec2(vMax.x - vMin.x, 0.f))) {
                                 last_integration_type = SurfaceIntegral;
                                 glUniform1i(glGetUniformLocation(shaderProgram, "integral"), SurfaceIntegral);
@@ -2423,7 +3677,7 @@ public:
                             ImGui::BeginDisabled(show_integral_result || second_corner);
                             if (ImGui::BeginCombo("##integrand", preview)) {
                                 for (int n = 1; n < graphs.size(); n++) {
-                                    if (!graphs[n].enabled) continue;
+                                    if (!graphs[n].enabled || graphs[n].form != Explicit) continue;
                                     const bool is_selected = (integrand_index == n);
                                     ImGui::PushStyleColor(ImGuiCol_Text, to_imcol32(graphs[n].color * 1.1f));
                                     if (ImGui::Selectable(graphs[n].defn, is_selected))
@@ -2535,6 +3789,9 @@ public:
                 ImGui::End();
             }
 
+            // every frame, so that picks requested while the info window is
+            // not shown are still retired and the loop can wait again
+            poll_picks();
             double x, y;
             glfwGetCursorPos(window, &x, &y);
             x = round(x);
@@ -2542,22 +3799,8 @@ public:
             if (graphs.size() > 0 && x - sidebarWidth > 0. && x - sidebarWidth < (wWidth - sidebarWidth) && y > 0. && y < wHeight &&
                 glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_RELEASE && zoomSpeed == 1.f && !ImGui::GetIO().WantCaptureMouse && !autoRotate) {
                 // depth check not needed since 977ef16
-                float depth[1];
-                glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-                glBindTexture(GL_TEXTURE_2D, prevZBuffer);
-                glReadPixels(ssaa_factor * x * dpi_scale, ssaa_factor * (wHeight - y) * dpi_scale, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
-                if (depth[0] == 0.f) goto mouse_not_on_graph;
-
-                glBindBuffer(GL_SHADER_STORAGE_BUFFER, posBuffer);
-                float data[6];
-                glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 6 * (floor((wWidth - sidebarWidth) * dpi_scale) * floor(y * dpi_scale) + floor((x - sidebarWidth) * dpi_scale)) * sizeof(float), 6 * sizeof(float), data);
-                fragPos = { data[0], data[1], data[2] };
-                graph_index = static_cast<int>(data[3]);
-                gradient = { data[4], data[5] };
-
-                if (graph_index >= graphs.size() || graph_index == 0) {
-                    goto mouse_not_on_graph;
-                }
+                // the latest pick that has arrived, requested a frame or two ago
+                if (!resolve_pick(graph_index, fragPos, gradient)) goto mouse_not_on_graph;
                 cursor_on_point = true;
                 ImVec2 prevWindowSize;
                 if (!rightClickPressed) {
@@ -2589,7 +3832,7 @@ public:
 
                 if (gradient_vector) {
                     vector_start = to_worldspace(fragPos);
-                    vector_end = to_worldspace(fragPos + vec3(data[4], data[5], pow(length(gradient), 2)));
+                    vector_end = to_worldspace(fragPos + vec3(gradient, pow(length(gradient), 2)));
                 }
                 if (normal_vector) {
                     vector_start = to_worldspace(fragPos);
@@ -2598,8 +3841,8 @@ public:
 
                 GLfloat params[5] = { fragPos.z, gradient.x, fragPos.x, gradient.y, fragPos.y };
                 if (tangent_plane && !rightClickPressed) {
-                    glUseProgram(graphs[0].computeProgram);
-                    glUniform1fv(glGetUniformLocation(graphs[0].computeProgram, "plane_params"), 5, params);
+                    memcpy(graphs[0].plane_params, params, sizeof(params));
+                    graphs[0].version++;
                     graphs[0].enabled = true;
                     vec4 nc1 = colors[(graphs.size() - 1) % colors.size()];
                     vec4 nc2 = colors[(graphs.size()) % colors.size()];
@@ -2627,11 +3870,10 @@ public:
                     const char* eq = "%.6f%+.6f*(x%+.6f)%+.6f*(y%+.6f)";
                     char eqf[88]{};
                     snprintf(eqf, 88, eq, params[0], params[1], -params[2], params[3], -params[4]);
-                    graphs.push_back(Graph(graphs.size(), UserDefined, eqf, 100, colors[(graphs.size() - 1) % colors.size()], colors[(graphs.size()) % colors.size()], true, gridSSBO, EBO));
+                    graphs.push_back(Graph(graphs.size(), UserDefined, eqf, 100, colors[(graphs.size() - 1) % colors.size()], colors[(graphs.size()) % colors.size()], true));
                     for (Slider& s : sliders) {
                         s.used_in.push_back(false);
                     }
-                    graphs[graphs.size() - 1].setup();
                     graphs[graphs.size() - 1].upload_definition(sliders);
                     graphs[graphs.size() - 1].grid_lines = graphs[graph_index].grid_lines;
                     apply_tangent_plane = false;
@@ -2704,6 +3946,13 @@ public:
                 //ImGui::SetNextWindowPos(ImVec2(w.x, w.y));
                 static bool result_window = true;
                 std::string x_display, y_display, s_display;
+                auto integral_progress = [&]() {
+                    if (!integral_job.active) return;
+                    ImGui::ProgressBar((float)integral_job.summed_rows / integral_job.group_rows, ImVec2(200.f, 0.f));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Cancel"))
+                        result_window = false;
+                };
                 ImVec2 size;
                 ImVec2 pos = { w.x, w.y };
                 switch (last_integration_type) {
@@ -2736,6 +3985,7 @@ public:
                     ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(120, 120, 120, 255));
                     ImGui::Text(U8(u8"\u2206x = %.3e, \u2206y = %.3e"), dx, dy);
                     ImGui::PopStyleColor();
+                    integral_progress();
                     ImGui::End();
                     break;
                 case SurfaceIntegral:
@@ -2770,6 +4020,7 @@ public:
                     ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(120, 120, 120, 255));
                     ImGui::Text(U8(u8"\u2206x = %.3e, \u2206y = %.3e"), dx, dy);
                     ImGui::PopStyleColor();
+                    integral_progress();
                     ImGui::End();
                     break;
                 case LineIntegral:
@@ -2798,6 +4049,7 @@ public:
                 }
 
                 if (result_window == false) {
+                    cancel_integral_job();
                     show_integral_result = apply_integral = second_corner = false;
                     glUniform1i(glGetUniformLocation(shaderProgram, "integral"), false);
                     if (integrand_index != -1) graphs[integrand_index].upload_definition(sliders);
@@ -2817,11 +4069,10 @@ public:
                     const char* eq = "%.6f%+.6f*(x%+.6f)%+.6f*(y%+.6f)";
                     char eqf[88]{};
                     snprintf(eqf, 88, eq, fragPos.z, gradient.x, -fragPos.x, gradient.y, -fragPos.y);
-                    graphs.push_back(Graph(graphs.size(), UserDefined, eqf, 100, colors[(graphs.size() - 1) % colors.size()], colors[(graphs.size()) % colors.size()], true, gridSSBO, EBO));
+                    graphs.push_back(Graph(graphs.size(), UserDefined, eqf, 100, colors[(graphs.size() - 1) % colors.size()], colors[(graphs.size()) % colors.size()], true));
                     for (Slider& s : sliders) {
                         s.used_in.push_back(false);
                     }
-                    graphs[graphs.size() - 1].setup();
                     graphs[graphs.size() - 1].upload_definition(sliders);
                     graphs[graphs.size() - 1].grid_lines = graphs[graph_index].grid_lines;
                 }
@@ -2854,84 +4105,155 @@ public:
             auto cameraPos = vec3(sin(radians(theta)) * cos(radians(phi)), cos(radians(theta)), sin(radians(theta)) * sin(radians(phi)));
             view = lookAt(cameraPos, vec3(0.f), { 0.f, 1.f, 0.f });
             proj = ortho(-1.f, 1.f, -(float)wHeight / (float)(wWidth - sidebarWidth), (float)wHeight / (float)(wWidth - sidebarWidth), -5.f, 5.f);
-            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "vpmat"), 1, GL_FALSE, value_ptr(proj * view));
+            // under TAA the scene is drawn offset by a sub-pixel of a 16 frame
+            // Halton (2, 3) sequence, proj stays unjittered for picking
+            vec2 jitter(0.f);
+            if (aa_mode == TAA) {
+                auto halton = [](int i, int base) {
+                    float f = 1.f, r = 0.f;
+                    for (; i > 0; i /= base) {
+                        f /= base;
+                        r += f * (i % base);
+                    }
+                    return r;
+                };
+                int i = frameCount % 16 + 1;
+                jitter = (vec2(halton(i, 2), halton(i, 3)) - 0.5f) * 2.f / vec2((wWidth - sidebarWidth) * render_scale * dpi_scale, wHeight * render_scale * dpi_scale);
+            }
+            mat4 scene_proj = translate(mat4(1.f), vec3(jitter, 0.f)) * proj;
+            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "vpmat"), 1, GL_FALSE, value_ptr(scene_proj * view));
             glUniform3fv(glGetUniformLocation(shaderProgram, "cameraPos"), 1, value_ptr(cameraPos));
 
+            // a widget counts once its value changes or while it's dragged, not
+            // while a text field merely has focus
+            if (ImGui::GetCurrentContext()->ActiveIdHasBeenEditedThisFrame || ImGui::IsAnyItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left))
+                interactionTimestamp = currentTime;
+            bool interacting = currentTime - interactionTimestamp < 0.15;
+
             ImGui::Render();
 
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, posBuffer);
-            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+            glBeginQuery(GL_TIME_ELAPSED, frameQueries[frameCount % 2]);
 
             glClearColor(0.0f, 0.0f, 0.0f, 1.f);
             glClearDepth(0.f);
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            
-            glViewport(sidebarWidth * ssaa_factor * dpi_scale, 0, (wWidth - sidebarWidth) * ssaa_factor * dpi_scale, wHeight * ssaa_factor * dpi_scale);
-            glUniform2i(glGetUniformLocation(shaderProgram, "regionSize"), (wWidth - sidebarWidth) * ssaa_factor * dpi_scale, wHeight * ssaa_factor * dpi_scale);
-            glUniform2i(glGetUniformLocation(shaderProgram, "windowSize"), wWidth * ssaa_factor * dpi_scale, wHeight * ssaa_factor * dpi_scale);
+            GLuint sceneFBO = aa_mode == MSAA ? msaaFBO : FBO;
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+            // glClear is undefined on the integer pick attachment
+            const GLfloat background[]{ 0.f, 0.f, 0.f, 1.f };
+            const GLuint no_pick[]{ 0, 0, 0, 0 };
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferfv(GL_COLOR, 0, background);
+            glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glClearBufferuiv(GL_COLOR, 1, no_pick);
+            glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+            glViewport(sidebarWidth * render_scale * dpi_scale, 0, (wWidth - sidebarWidth) * render_scale * dpi_scale, wHeight * render_scale * dpi_scale);
+            glUniform2i(glGetUniformLocation(shaderProgram, "regionSize"), (wWidth - sidebarWidth) * render_scale * dpi_scale, wHeight * render_scale * dpi_scale);
+            glUniform2i(glGetUniformLocation(shaderProgram, "windowSize"), wWidth * render_scale * dpi_scale, wHeight * render_scale * dpi_scale);
 
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, sliderBuffer);
             std::vector<float> values(sliders.size());
             for (int i = 0; i < values.size(); i++)
                 values[i] = sliders[i].value;
-            glBufferData(GL_SHADER_STORAGE_BUFFER, values.size() * sizeof(float), values.data(), GL_DYNAMIC_DRAW);
+            // the history survives camera rotation only, which is reprojected
+            history_valid &= !interacting;
+            if (values != slider_values) {
+                history_valid = false;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, sliderBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, values.size() * sizeof(float), values.data(), GL_DYNAMIC_DRAW);
+                slider_values = values;
+            }
+            step_integral_job();
+            for (Graph& g : graphs) g.poll_definition();
 
+            // of the graphs drawn this frame, which alone are evaluated and refined
+            std::vector<bool> rendered(graphs.size(), false);
             auto render_graph = [&](int i) {
-                const Graph& g = graphs[i];
-                g.use_compute(zoomx, zoomy, zoomz, centerPos);
-                glDispatchCompute(g.grid_res + 2, g.grid_res + 2, 1);
-                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                Graph& g = graphs[i];
+                rendered[i] = true;
+                uint64_t stamp = g.stamp;
+                ivec2 origin = g.origin;
+                int stride = g.stride;
+                bool implicit = g.form == Implicit;
+                if (implicit) g.polygonize(sliders, zoomx, zoomy, zoomz, centerPos, triangleTable, res_scale);
+                else g.evaluate(sliders, zoomx, zoomy, zoomz, centerPos, cpu_evaluation, interacting, res_scale);
+                history_valid &= g.stamp == stamp && g.origin == origin && g.stride == stride;
+                // the uniform strip stands in while the grid is still being refined,
+                // and until the errors of the adaptive mesh have been read back
+                bool explicit_graph = g.form == Explicit;
+                bool adaptive = g.adaptive && g.stride == 1 && !interacting && explicit_graph;
+                if (adaptive && g.mesh_dirty) {
+                    build_mesh(g);
+                    history_valid &= g.mesh_dirty;
+                }
+                adaptive &= !g.mesh_dirty;
+                if (g.vector_field && g.type != TangentPlane && explicit_graph) {
+                    update_vector_field(g);
+                    draw_vector_instances(g.fieldBuffer, g.field_res * g.field_res, view, scene_proj);
+                }
                 glUseProgram(shaderProgram);
-                g.use_shader();
                 glUniform1i(glGetUniformLocation(shaderProgram, "index"), i);
                 glUniform4fv(glGetUniformLocation(shaderProgram, "color"), 1, value_ptr(g.color));
                 glUniform4fv(glGetUniformLocation(shaderProgram, "secondary_color"), 1, value_ptr(g.secondary_color));
-                glUniform1i(glGetUniformLocation(shaderProgram, "grid_res"), g.grid_res);
+                glUniform1i(glGetUniformLocation(shaderProgram, "grid_res"), g.eval_res);
+                glUniform2i(glGetUniformLocation(shaderProgram, "wrap"), g.wrap.x, g.wrap.y);
+                glUniform2fv(glGetUniformLocation(shaderProgram, "lattice_shift"), 1, value_ptr(g.lattice_shift(zoomx, zoomy, centerPos)));
+                glUniform1i(glGetUniformLocation(shaderProgram, "mesh_res"), g.mesh_res());
+                glUniform1i(glGetUniformLocation(shaderProgram, "mesh_stride"), g.stride);
+                glUniform2i(glGetUniformLocation(shaderProgram, "mesh_first"), g.align(g.origin.x) - g.origin.x, g.align(g.origin.y) - g.origin.y);
                 glUniform1i(glGetUniformLocation(shaderProgram, "tangent_plane"), g.type == TangentPlane);
                 glUniform1f(glGetUniformLocation(shaderProgram, "shininess"), g.shininess);
                 glUniform1f(glGetUniformLocation(shaderProgram, "gridLineDensity"), g.grid_lines ? gridLineDensity : 0.f);
-                glBindVertexArray(VAO);
+                glBindVertexArray(graphVAO);
                 glUniform1i(glGetUniformLocation(shaderProgram, "quad"), false);
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, prevZBuffer);
-                glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)g.indices.size(), GL_UNSIGNED_INT, 0);
-            };
-
-            auto write_to_prevzbuf = [&]() {
-                glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFBO);
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFBO);
-                glBlitFramebuffer(
-                    0, 0, ssaa_factor * wWidth * dpi_scale, ssaa_factor * wHeight * dpi_scale,
-                    0, 0, ssaa_factor * wWidth * dpi_scale, ssaa_factor * wHeight * dpi_scale,
-                    GL_DEPTH_BUFFER_BIT, GL_NEAREST
-                );
-                glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+                glUniform1i(glGetUniformLocation(shaderProgram, "mesh_indexed"), adaptive);
+                glUniform1i(glGetUniformLocation(shaderProgram, "mesh_vertices"), implicit);
+                glUniform1i(glGetUniformLocation(shaderProgram, "parametric"), g.form == Parametric);
+                // the tangent plane, implicit surfaces, which picks cannot re-evaluate,
+                // and while integrating every graph but the integrand are not picked
+                bool pickable = g.type != TangentPlane && !implicit && (!(integral && second_corner || show_integral_result) || i == integrand_index);
+                glColorMaski(1, pickable, pickable, pickable, pickable);
+                if (implicit) {
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, g.meshBuffer);
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g.drawBuffer);
+                    glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+                }
+                else if (adaptive) {
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g.EBO);
+                    glDrawElements(GL_TRIANGLES, g.mesh_indices, GL_UNSIGNED_INT, nullptr);
+                }
+                else glDrawArrays(GL_TRIANGLE_STRIP, 0, g.strip_vertices());
+                glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glBindVertexArray(VAO);
+                if (g.contours && g.type != TangentPlane && explicit_graph)
+                    draw_contours(g, view, scene_proj);
             };
 
             if (show_axes) {
-                draw_vector(to_worldspace(clamp({ xrange[1], 0.f, 0.f }, vec3(-FLT_MAX, yrange[1], zrange[1]), vec3(FLT_MAX, yrange[0], zrange[0]))),
+                add_vector(to_worldspace(clamp({ xrange[1], 0.f, 0.f }, vec3(-FLT_MAX, yrange[1], zrange[1]), vec3(FLT_MAX, yrange[0], zrange[0]))),
                     to_worldspace(clamp({ xrange[0], 0.f, 0.f }, vec3(-FLT_MAX, yrange[1], zrange[1]), vec3(FLT_MAX, yrange[0], zrange[0]))),
-                    vec3(0.8f, 0.f, 0.f), view, proj, 0.7f);
-                draw_vector(to_worldspace(clamp({ 0.f, yrange[1], 0.f }, vec3(xrange[1], -FLT_MAX, zrange[1]), vec3(xrange[0], FLT_MAX, zrange[0]))),
+                    vec3(0.8f, 0.f, 0.f), 0.7f);
+                add_vector(to_worldspace(clamp({ 0.f, yrange[1], 0.f }, vec3(xrange[1], -FLT_MAX, zrange[1]), vec3(xrange[0], FLT_MAX, zrange[0]))),
                     to_worldspace(clamp({ 0.f, yrange[0], 0.f }, vec3(xrange[1], -FLT_MAX, zrange[1]), vec3(xrange[0], FLT_MAX, zrange[0]))),
-                    vec3(0.f, 0.7f, 0.f), view, proj, 0.7f);
-                draw_vector(to_worldspace(clamp({ 0.f, 0.f, zrange[1] }, vec3(xrange[1], yrange[1], -FLT_MAX), vec3(xrange[0], yrange[0], FLT_MAX))),
+                    vec3(0.f, 0.7f, 0.f), 0.7f);
+                add_vector(to_worldspace(clamp({ 0.f, 0.f, zrange[1] }, vec3(xrange[1], yrange[1], -FLT_MAX), vec3(xrange[0], yrange[0], FLT_MAX))),
                     to_worldspace(clamp({ 0.f, 0.f, zrange[0] }, vec3(xrange[1], yrange[1], -FLT_MAX), vec3(xrange[0], yrange[0], FLT_MAX))),
-                    vec3(0.f, 0.5f, 1.f), view, proj, 0.7f);
+                    vec3(0.f, 0.5f, 1.f), 0.7f);
             }
 
+            if ((gradient_vector || normal_vector) && cursor_on_point)
+                add_vector(vector_start, vector_end, graphs[graph_index].secondary_color);
+            // opaque, so before the graphs that may blend over them
+            draw_vectors(view, scene_proj);
+
             if (integral && second_corner || show_integral_result && last_integration_type < 3) {
                 render_graph(integrand_index);
-                write_to_prevzbuf();
             } else if (show_integral_result && last_integration_type == LineIntegral) {
-                draw_lineintegral(graphs[integrand_index].color, view, proj);
+                draw_lineintegral(graphs[integrand_index].color, view, scene_proj);
                 glDisable(GL_DEPTH_TEST);
                 render_graph(integrand_index);
                 glEnable(GL_DEPTH_TEST);
-                write_to_prevzbuf();
             }
             for (int i = 1; i < graphs.size(); i++) {
                 const Graph& g = graphs[i];
@@ -2939,26 +4261,100 @@ public:
                 if (i == integrand_index && (integral && second_corner || show_integral_result)) continue;
                 render_graph(i);
             }
-            if (!integral || !second_corner && !show_integral_result)
-                write_to_prevzbuf();
             if (graphs[0].enabled)
                 render_graph(0);
-            if ((gradient_vector || normal_vector) && cursor_on_point)
-                draw_vector(vector_start, vector_end, graphs[graph_index].secondary_color, view, proj);
 
-            glViewport(sidebarWidth * dpi_scale, 0, (wWidth - sidebarWidth) * dpi_scale, wHeight * dpi_scale);
+            GLsizei frameWidth = wWidth * render_scale * dpi_scale, frameHeight = wHeight * render_scale * dpi_scale;
+            if (aa_mode == MSAA) {
+                // resolved into FBO, whose picks the cursor is read from; an
+                // attachment at a time, the pick one holds integers
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFBO);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+                for (GLenum attachment : { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 }) {
+                    glReadBuffer(attachment);
+                    glDrawBuffer(attachment);
+                    glBlitFramebuffer(0, 0, frameWidth, frameHeight, 0, 0, frameWidth, frameHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                }
+                const GLenum attachments[]{ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+                glDrawBuffers(2, attachments);
+                glReadBuffer(GL_COLOR_ATTACHMENT0);
+            }
+
+            double cursorX, cursorY;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            cursorX = round(cursorX);
+            cursorY = round(cursorY);
+            if (cursorX - sidebarWidth > 0. && cursorX - sidebarWidth < (wWidth - sidebarWidth) && cursorY > 0. && cursorY < wHeight &&
+                (animating || redraw_frames > 0 || pick_cursor != ivec2(cursorX, cursorY) || cell_outdated())) {
+                pick_cursor = ivec2(cursorX, cursorY);
+                request_pick(cursorX, cursorY, wHeight);
+            }
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, frameTex);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
             glUniform1i(glGetUniformLocation(shaderProgram, "quad"), true);
+            int resolve = aa_mode == FXAA ? ResolveFXAA : ResolveCopy;
+            if (aa_mode == SSAA && render_scale > 1.f) {
+                // a Gaussian separated into rows then columns, 2(2r+1) taps per pixel instead of (2r+1)^2
+                glBindFramebuffer(GL_FRAMEBUFFER, downsampleFBO);
+                glViewport(sidebarWidth * dpi_scale, 0, (wWidth - sidebarWidth) * dpi_scale, frameHeight);
+                glUniform1i(glGetUniformLocation(shaderProgram, "resolve"), ResolveHorizontal);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glBindTexture(GL_TEXTURE_2D, downsampleTex);
+                resolve = ResolveVertical;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(sidebarWidth * dpi_scale, 0, (wWidth - sidebarWidth) * dpi_scale, wHeight * dpi_scale);
+            if (aa_mode == TAA) {
+                // blended over the reprojected history, which is then what is shown
+                GLuint current = frameCount % 2;
+                mat4 vpmat = proj * view;
+                glBindFramebuffer(GL_FRAMEBUFFER, historyFBO[current]);
+                glViewport(sidebarWidth * dpi_scale, 0, (wWidth - sidebarWidth) * dpi_scale, wHeight * dpi_scale);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, historyTex[1 - current]);
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_2D, depthMap);
+                glUniform1i(glGetUniformLocation(shaderProgram, "history_valid"), history_valid);
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "reprojection"), 1, GL_FALSE, value_ptr(history_vpmat * inverse(vpmat)));
+                glUniform2fv(glGetUniformLocation(shaderProgram, "jitter"), 1, value_ptr(jitter));
+                glUniform1i(glGetUniformLocation(shaderProgram, "resolve"), ResolveTAA);
+                glDisable(GL_BLEND);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glEnable(GL_BLEND);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, historyTex[current]);
+                history_frames = history_valid ? history_frames + 1 : 1;
+                history_valid = true;
+                history_vpmat = vpmat;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(sidebarWidth * dpi_scale, 0, (wWidth - sidebarWidth) * dpi_scale, wHeight * dpi_scale);
+            glUniform1i(glGetUniformLocation(shaderProgram, "resolve"), resolve);
             glDrawArrays(GL_TRIANGLES, 0, 6);
+            glEndQuery(GL_TIME_ELAPSED);
 
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
             glfwSwapBuffers(window);
             glDepthFunc(GL_GREATER);
 
+            // anything that changes the next frame without an event keeps the loop drawing
+            animating = autoRotate || interacting || keys.any() || integral_job.active
+                || aa_mode == TAA && history_frames < 16;
+            // implicit surfaces keep no stride but may grow their mesh, and only
+            // explicit graphs rebuild an adaptive one
+            for (int i = 0; i < graphs.size(); i++) {
+                const Graph& g = graphs[i];
+                if (!rendered[i]) continue;
+                animating |= g.compiling || g.form != Implicit && g.stride > 1
+                    || g.form == Explicit && g.adaptive && g.mesh_dirty || g.form == Implicit && g.countFence;
+            }
+
         } while (!glfwWindowShouldClose(window));
+
+        // program_cache is static, destroyed only once the contexts are gone
+        program_cache.stop_worker();
+        if (compileWindow) glfwDestroyWindow(compileWindow);
     }
 };
 
@@ -0,0 +1,155 @@
+// Headless checks of the expression compiler and the CPU backend, for
+// machines without a GPU: known definitions are evaluated over a small
+// lattice and compared with their closed forms.
+
+#include <cpu_evaluator.hpp>
+
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <functional>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (condition) return;
+    std::printf("FAILED: %s\n", what.c_str());
+    failures++;
+}
+
+static bool close(float a, float b, float tolerance = 1e-4f) {
+    return std::abs(a - b) <= tolerance * std::max(1.f, std::abs(b));
+}
+
+// the symbols Graph::generate_source gives an explicit definition, with one slider a
+static SymbolTable definition_symbols() {
+    SymbolTable symbols;
+    symbols.add_variable("x");
+    symbols.add_variable("y");
+    symbols.add_macro("t", "atan(-y, -x) + PI");
+    symbols.add_constant("PI", M_PI);
+    symbols.add_constant("e", M_E);
+    symbols.add_array("plane_params", 5);
+    symbols.add_slider("a", 0);
+    return symbols;
+}
+
+static SymbolTable field_symbols() {
+    SymbolTable fields = definition_symbols();
+    fields.add_variable("z");
+    fields.add_variable("px");
+    fields.add_variable("py");
+    return fields;
+}
+
+struct Grid {
+    CpuEvaluator evaluator;
+    CpuEvaluator::View view{ 8, 4.f, 4.f, 1.f, 0.5f, -0.25f };
+    std::vector<float> sliders{ 3.f };
+    float plane_params[5]{};
+    std::vector<float> points;
+
+    bool compile(const char* definition, const char* region = "true", const char* scalar_field = "z") {
+        Expression f, scalar, inside;
+        std::string error;
+        bool ok = f.parse(definition, definition_symbols(), error)
+            && scalar.parse(scalar_field, field_symbols(), error)
+            && inside.parse(region, field_symbols(), error, true)
+            && evaluator.compile(f, scalar, inside, error);
+        check(ok, std::format("'{}' over '{}' compiles: {}", definition, region, error));
+        return ok;
+    }
+
+    void evaluate() {
+        points.assign((size_t)view.grid_res * view.grid_res * CpuEvaluator::point_floats, 0.f);
+        evaluator.evaluate(points.data(), view, sliders, plane_params);
+    }
+
+    // the cell-centred lattice point of compute.glsl
+    float x(int col) const { return view.zoomx * ((col + 0.5f) / view.grid_res - 0.5f) + view.centerx; }
+    float y(int row) const { return view.zoomy * ((row + 0.5f) / view.grid_res - 0.5f) + view.centery; }
+    const float* at(int row, int col) const { return &points[((size_t)row * view.grid_res + col) * CpuEvaluator::point_floats]; }
+};
+
+// z = f(x, y) with its partial derivatives over the whole lattice
+static void expect_surface(const char* definition, std::function<float(float, float)> f,
+                           std::function<float(float, float)> fx, std::function<float(float, float)> fy) {
+    Grid grid;
+    if (!grid.compile(definition)) return;
+    grid.evaluate();
+    int wrong = 0;
+    for (int row = 0; row < grid.view.grid_res; row++) {
+        for (int col = 0; col < grid.view.grid_res; col++) {
+            float x = grid.x(col), y = grid.y(row);
+            const float* p = grid.at(row, col);
+            wrong += !close(p[0], f(x, y)) || p[1] != 1.f || !close(p[2], fx(x, y)) || !close(p[3], fy(x, y));
+        }
+    }
+    check(wrong == 0, std::format("'{}' has {} wrong points", definition, wrong));
+}
+
+static void expect_region(const char* region, std::function<bool(float, float)> inside) {
+    Grid grid;
+    if (!grid.compile("x + y", region)) return;
+    grid.evaluate();
+    int wrong = 0;
+    for (int row = 0; row < grid.view.grid_res; row++)
+        for (int col = 0; col < grid.view.grid_res; col++)
+            wrong += grid.at(row, col)[1] != (inside(grid.x(col), grid.y(row)) ? 1.f : 0.f);
+    check(wrong == 0, std::format("region '{}' has {} wrong points", region, wrong));
+}
+
+static void expect_error(const char* source, const char* message, bool condition = false) {
+    Expression expr;
+    std::string error;
+    bool ok = expr.parse(source, field_symbols(), error, condition);
+    check(!ok && error.find(message) != std::string::npos, std::format("'{}' fails with '{}', got '{}'", source, message, error));
+}
+
+int main() {
+    expect_surface("x * y + 2", [](float x, float y) { return x * y + 2.f; },
+        [](float x, float y) { return y; }, [](float x, float y) { return x; });
+    expect_surface("x^3 - 2 * y", [](float x, float y) { return x * x * x - 2.f * y; },
+        [](float x, float y) { return 3.f * x * x; }, [](float x, float y) { return -2.f; });
+    expect_surface("sin(x)^2 + cos(x)^2", [](float x, float y) { return 1.f; },
+        [](float x, float y) { return 0.f; }, [](float x, float y) { return 0.f; });
+    expect_surface("exp(-(x * x + y * y))", [](float x, float y) { return std::exp(-(x * x + y * y)); },
+        [](float x, float y) { return -2.f * x * std::exp(-(x * x + y * y)); },
+        [](float x, float y) { return -2.f * y * std::exp(-(x * x + y * y)); });
+    expect_surface("a * x", [](float x, float y) { return 3.f * x; },
+        [](float x, float y) { return 3.f; }, [](float x, float y) { return 0.f; });
+    expect_surface("x > 0 ? x : -x", [](float x, float y) { return std::abs(x); },
+        [](float x, float y) { return x > 0.f ? 1.f : -1.f; }, [](float x, float y) { return 0.f; });
+    expect_surface("t", [](float x, float y) { return std::atan2(-y, -x) + (float)M_PI; },
+        [](float x, float y) { return -y / (x * x + y * y); }, [](float x, float y) { return x / (x * x + y * y); });
+
+    // the regions graphs are drawn with and those of the integral tools
+    expect_region("true", [](float x, float y) { return true; });
+    expect_region("false", [](float x, float y) { return false; });
+    expect_region("x * x + y * y < 1", [](float x, float y) { return x * x + y * y < 1.f; });
+    expect_region("float(-0.5) <= x && x <= float(1) && !(y > 0)", [](float x, float y) { return -0.5f <= x && x <= 1.f && !(y > 0.f); });
+
+    // a surface integral's scalar field summed over a region
+    {
+        Grid grid;
+        if (grid.compile("x", "x > 0", "(1) * sqrt(px * px + py * py + 1)")) {
+            double expected = 0.0;
+            for (int row = 0; row < grid.view.grid_res; row++)
+                for (int col = 0; col < grid.view.grid_res; col++)
+                    if (grid.x(col) > 0.f) expected += std::sqrt(2.0);
+            double sum = grid.evaluator.sum(grid.view, grid.sliders, grid.plane_params);
+            check(std::abs(sum - expected) < 1e-3, std::format("sum is {}, expected {}", sum, expected));
+        }
+    }
+
+    expect_error("x +", "expected a value");
+    expect_error("q * x", "undeclared identifier 'q'");
+    expect_error("x < 1", "must be a number");
+    expect_error("x + 1", "must be a condition", true);
+    expect_error("true + 1", "must be numbers");
+    expect_error("sin(x, y)", "takes 1 argument");
+
+    if (failures == 0) std::printf("all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}